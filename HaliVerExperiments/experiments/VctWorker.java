@@ -0,0 +1,163 @@
+import java.io.BufferedReader;
+import java.io.FileOutputStream;
+import java.io.InputStreamReader;
+import java.io.PrintStream;
+import java.lang.reflect.InvocationTargetException;
+import java.lang.reflect.Method;
+import java.lang.reflect.Proxy;
+import java.lang.reflect.UndeclaredThrowableException;
+import java.security.Permission;
+import java.util.concurrent.Callable;
+
+/**
+ * Long-running VerCors process used by vct_server.py.
+ *
+ * Reads jobs from stdin and runs each of them through vct.main.Main in this JVM, so
+ * class loading and JIT warm-up are paid once per worker instead of once per file.
+ * A job is sent as:
+ *   <stdout file>\n<stderr file>\n<number of arguments>\n<argument>\n...
+ * and answered on stdout with "DONE <exit code>". Output of the job itself goes to the
+ * given files. A worker runs one job at a time; the server runs several workers for
+ * concurrency, kills a worker whose job runs past its deadline and replaces a worker
+ * after a fixed number of jobs, by default after every job.
+ *
+ * Static state of VerCors (caches, counters, settings of Scala objects) is not reset
+ * between jobs. It is only cleared when the server replaces the worker, so when the
+ * server reuses workers a job can observe state left by an earlier job of the same worker.
+ */
+public class VctWorker {
+    static final int EXIT_CODE_ERROR = 1;
+
+    static class ExitException extends SecurityException {
+        final int status;
+
+        ExitException(int status) {
+            super("System.exit(" + status + ")");
+            this.status = status;
+        }
+    }
+
+    // VerCors calls System.exit on some paths, which would take the worker down with it.
+    @SuppressWarnings("removal")
+    static class NoExitSecurityManager extends SecurityManager {
+        @Override
+        public void checkExit(int status) {
+            throw new ExitException(status);
+        }
+
+        @Override
+        public void checkPermission(Permission perm) {
+        }
+
+        @Override
+        public void checkPermission(Permission perm, Object context) {
+        }
+    }
+
+    // Scala objects expose their methods as static forwarders, fall back on MODULE$ otherwise.
+    static Object invokeObject(String className, String method, Class<?>[] types, Object... args)
+            throws Exception {
+        try {
+            Method m = Class.forName(className).getMethod(method, types);
+            return m.invoke(null, args);
+        } catch (NoSuchMethodException e) {
+            Object module = Class.forName(className + "$").getField("MODULE$").get(null);
+            Method m = module.getClass().getMethod(method, types);
+            return m.invoke(module, args);
+        }
+    }
+
+    // Runs body with scala.Console.out or scala.Console.err (method withOut or withErr) bound
+    // to stream. Scala code prints through scala.Console, which keeps the System.out it saw
+    // when it was first used, so System.setOut alone does not redirect it. Uses reflection,
+    // so the worker compiles without the Scala library.
+    static Object withConsole(String method, PrintStream stream, Callable<Object> body) throws Exception {
+        Class<?> function0 = Class.forName("scala.Function0");
+        Object thunk = Proxy.newProxyInstance(function0.getClassLoader(), new Class<?>[]{function0},
+            (proxy, m, a) -> {
+                switch (m.getName()) {
+                    case "apply": return body.call();
+                    case "toString": return "VctWorker job";
+                    case "hashCode": return System.identityHashCode(proxy);
+                    case "equals": return proxy == a[0];
+                    default: throw new UnsupportedOperationException(m.getName());
+                }
+            });
+        return invokeObject("scala.Console", method, new Class<?>[]{PrintStream.class, function0}, stream, thunk);
+    }
+
+    static int run(String[] args) throws Exception {
+        Class<?> optionsClass = Class.forName("vct.options.Options");
+        Object parsed = invokeObject("vct.options.Options", "parse", new Class<?>[]{String[].class}, (Object) args);
+        if ((Boolean) parsed.getClass().getMethod("isEmpty").invoke(parsed)) {
+            return EXIT_CODE_ERROR;
+        }
+        Object options = parsed.getClass().getMethod("get").invoke(parsed);
+        Object code = invokeObject("vct.main.Main", "runOptions", new Class<?>[]{optionsClass}, options);
+        return (Integer) code;
+    }
+
+    // The exception thrown by the job, without the wrappers of reflection and of the proxy
+    static Throwable unwrap(Throwable t) {
+        while ((t instanceof InvocationTargetException || t instanceof UndeclaredThrowableException)
+                && t.getCause() != null) {
+            t = t.getCause();
+        }
+        return t;
+    }
+
+    static int exitCode(Throwable t) {
+        while (t != null) {
+            if (t instanceof ExitException) {
+                return ((ExitException) t).status;
+            }
+            t = t.getCause();
+        }
+        return -1;
+    }
+
+    @SuppressWarnings("removal")
+    public static void main(String[] argv) throws Exception {
+        PrintStream control = System.out;
+        PrintStream stderr = System.err;
+        BufferedReader in = new BufferedReader(new InputStreamReader(System.in));
+        System.setSecurityManager(new NoExitSecurityManager());
+
+        control.println("READY");
+        control.flush();
+
+        String stdoutFile;
+        while ((stdoutFile = in.readLine()) != null) {
+            String stderrFile = in.readLine();
+            int n = Integer.parseInt(in.readLine().trim());
+            String[] args = new String[n];
+            for (int i = 0; i < n; i++) {
+                args[i] = in.readLine();
+            }
+
+            int code;
+            try (PrintStream out = new PrintStream(new FileOutputStream(stdoutFile), true);
+                 PrintStream err = new PrintStream(new FileOutputStream(stderrFile), true)) {
+                System.setOut(out);
+                System.setErr(err);
+                try {
+                    code = (Integer) withConsole("withOut", out,
+                        () -> withConsole("withErr", err, () -> run(args)));
+                } catch (Throwable t) {
+                    t = unwrap(t);
+                    code = exitCode(t);
+                    if (code == -1) {
+                        t.printStackTrace(err);
+                        code = EXIT_CODE_ERROR;
+                    }
+                } finally {
+                    System.setOut(control);
+                    System.setErr(stderr);
+                }
+            }
+
+            control.println("DONE " + code);
+            control.flush();
+        }
+    }
+}
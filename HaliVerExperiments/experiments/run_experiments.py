@@ -102,14 +102,16 @@ def main(input_files, i, command_template, output_xml, tags):
         xml_file.write(prettify_xml(root))
 
 def experiments(output_xml, i, non_unique=False, mem=False):
-    # Read input files from a file
+    # Read input files from a file, a line is the name of the experiment optionally followed
+    # by its schedules, by default 0 up to 3
     with open('experiments.txt', 'r') as file:
-        names = [line.strip() for line in file.readlines()]
+        lines = [line.split() for line in file.readlines() if line.strip()]
+    schedules = {line[0]: line[1:] if len(line) > 1 else range(0,4) for line in lines}
     
     postfix = ("_mem" if mem else "")
     postfix = postfix + ("_non_unique" if non_unique else "")
 
-    input_files = [f"{file}_{v}{postfix}.c" for file in names for v in range(0,4)]
+    input_files = [f"{file}_{v}{postfix}.c" for file in schedules for v in schedules[file]]
 
     if(mem):
         with open('experiments_mem.txt', 'r') as file:
@@ -120,9 +122,16 @@ def experiments(output_xml, i, non_unique=False, mem=False):
     tags = "normal" if postfix == "" else postfix
     main(input_files, i, command_template, output_xml, tags)
 
-def padre(output_xml, i, non_unique=False, cb=False):
-    names = ["StepHalide", "SubDirectionHalide", "SolveDirectionHalide", "PerformIterationHalide"]
-    postfix = ("CB" if cb else "")
+PADRE_PIPELINES = {
+    "Diagonal": ["StepHalide", "SubDirectionHalide", "SolveDirectionHalide"],
+    "Full": ["PerformIterationHalide"],
+    "Batched": ["StepBatchedHalide", "SubDirectionBatchedHalide", "SolveDirectionBatchedHalide"],
+    "Reorder": ["GatherIndicesHalide", "GatherVisibilitiesHalide", "RestoreVisibilitiesHalide"],
+}
+
+def padre(output_xml, i, non_unique=False, cb=False, suffix="", pipelines=("Diagonal", "Full", "Batched")):
+    names = [name for pipeline in pipelines for name in PADRE_PIPELINES[pipeline]]
+    postfix = ("CB" if cb else "") + suffix
     postfix = postfix + ("_non_unique" if non_unique else "")
 
     input_files = [f"{file}{postfix}.c" for file in names]
@@ -141,7 +150,12 @@ if __name__ == "__main__":
                        type=int,
                        help='Number of repetitions for each experiment (default: 1)')
 
+    parser.add_argument('--vct',
+                       default=VCT,
+                       help='vct executable, e.g. vct_client.py to use a running vct_server.py (default: vercors/bin/vct)')
+
     args = parser.parse_args()
+    VCT = os.path.abspath(args.vct)
     timestamp = args.timestamp
     repetitions = args.repetitions
     assert repetitions > 0
@@ -152,6 +166,16 @@ if __name__ == "__main__":
         padre(file, i, non_unique=True)
         padre(file, i, cb=True)
         padre(file, i, cb=True, non_unique=True)
+        padre(file, i, suffix="SC")
+        padre(file, i, suffix="SC", non_unique=True)
+        padre(file, i, suffix="Chunked", pipelines=["Full"])
+        padre(file, i, suffix="Chunked", pipelines=["Full"], non_unique=True)
+        padre(file, i, suffix="Private", pipelines=["Diagonal"])
+        padre(file, i, suffix="Private", pipelines=["Diagonal"], non_unique=True)
+        padre(file, i, suffix="Iter4", pipelines=["Full"])
+        padre(file, i, suffix="Iter4", pipelines=["Full"], non_unique=True)
+        padre(file, i, pipelines=["Reorder"])
+        padre(file, i, pipelines=["Reorder"], non_unique=True)
 
         file = f"results/exp-{timestamp}.xml"
         experiments(file, i)
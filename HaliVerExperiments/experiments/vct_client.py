@@ -0,0 +1,35 @@
+#!/usr/bin/env python3
+# Drop-in replacement for vct: sends the job to a running vct_server.py and falls back
+# to the real vct when no server is listening. Use it with
+#   cmake -DVCT=<path to>/vct_client.py ...
+import json
+import os
+import socket
+import sys
+
+from vct_server import VCT, default_socket_path
+
+def absolute_args(args):
+    # The server does not share our working directory, so pass files by absolute path.
+    return [os.path.abspath(arg) if not arg.startswith("-") and os.path.exists(arg) else arg
+            for arg in args]
+
+def main():
+    args = absolute_args(sys.argv[1:])
+    try:
+        connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        connection.connect(default_socket_path())
+    except OSError:
+        vct = os.environ.get("VCT_FALLBACK", VCT)
+        os.execv(vct, [vct] + args)
+
+    with connection:
+        connection.sendall((json.dumps({"args": args}) + "\n").encode())
+        reply = json.loads(connection.makefile("rb").readline().decode())
+
+    sys.stdout.write(reply["stdout"])
+    sys.stderr.write(reply["stderr"])
+    sys.exit(reply["return_code"])
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,227 @@
+import argparse
+import json
+import os
+import queue
+import select
+import shutil
+import signal
+import socketserver
+import subprocess
+import sys
+import tempfile
+
+DIR = os.path.dirname(os.path.abspath(__file__))
+VCT = f"{DIR}/../../vercors/bin/vct"
+WORKER_SOURCE = f"{DIR}/VctWorker.java"
+WORKER_CLASS = "VctWorker"
+
+def default_socket_path():
+    return os.environ.get("VCT_SERVER_SOCKET", f"/tmp/vct-server-{os.getuid()}.sock")
+
+def discover_classpath(vct):
+    # The java launcher prints its system properties to stderr when asked through
+    # JDK_JAVA_OPTIONS, which gives us the class path the vct script puts together.
+    env = dict(os.environ, JDK_JAVA_OPTIONS="-XshowSettings:properties")
+    process = subprocess.run([vct, "--version"], env=env, stdout=subprocess.PIPE,
+                             stderr=subprocess.PIPE, universal_newlines=True)
+    entries = []
+    in_classpath = False
+    for line in process.stderr.splitlines():
+        if line.strip().startswith("java.class.path = "):
+            entries.append(line.split("=", 1)[1].strip())
+            in_classpath = True
+        elif in_classpath and line.startswith("        "):
+            entries.append(line.strip())
+        else:
+            in_classpath = False
+    if not entries:
+        raise RuntimeError(f"Could not find the VerCors class path using {vct}, pass --classpath")
+    return os.pathsep.join(entries)
+
+def compile_worker(build_dir):
+    class_file = os.path.join(build_dir, f"{WORKER_CLASS}.class")
+    if not os.path.exists(class_file) or os.path.getmtime(class_file) < os.path.getmtime(WORKER_SOURCE):
+        os.makedirs(build_dir, exist_ok=True)
+        subprocess.run(["javac", "-d", build_dir, WORKER_SOURCE], check=True)
+
+class Worker:
+    def __init__(self, command):
+        self.jobs = 0
+        self.process = subprocess.Popen(command, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                        universal_newlines=True)
+        self.ready = False
+
+    def wait_ready(self):
+        # The JVM starts in the background, so a replaced worker boots while other jobs run
+        if not self.ready:
+            if self.process.stdout.readline().strip() != "READY":
+                raise RuntimeError("VerCors worker did not start")
+            self.ready = True
+
+    def alive(self):
+        return self.process.poll() is None
+
+    def run(self, args, job_dir, timeout):
+        stdout_file = os.path.join(job_dir, "stdout")
+        stderr_file = os.path.join(job_dir, "stderr")
+        request = [stdout_file, stderr_file, str(len(args))] + args
+        self.wait_ready()
+        self.jobs += 1
+        timed_out = False
+        try:
+            self.process.stdin.write("\n".join(request) + "\n")
+            self.process.stdin.flush()
+            # The worker answers with a single line once the job is done
+            ready, _, _ = select.select([self.process.stdout], [], [], timeout)
+            if ready:
+                reply = self.process.stdout.readline().split()
+            else:
+                # A hung job would keep this worker busy forever, kill it so the pool replaces it
+                timed_out = True
+                reply = []
+                self.process.kill()
+                self.process.wait()
+        except BrokenPipeError:
+            reply = []
+
+        if len(reply) == 2 and reply[0] == "DONE":
+            return_code = int(reply[1])
+        else:
+            return_code = 1
+
+        with open(stdout_file, errors="replace") as f:
+            stdout = f.read()
+        with open(stderr_file, errors="replace") as f:
+            stderr = f.read()
+        if timed_out:
+            stderr += f"\nvct_server: the job did not finish within {timeout} seconds, its worker was killed.\n"
+        elif not reply:
+            stderr += "\nThe VerCors worker stopped while running this job.\n"
+        return return_code, stdout, stderr
+
+    def stop(self):
+        if self.alive():
+            self.process.stdin.close()
+            try:
+                self.process.wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                self.process.kill()
+
+class WorkerPool:
+    """At most `jobs` workers, each running a single job at a time.
+
+    A job that runs longer than `job_timeout` seconds kills its worker, which is replaced.
+    Workers are also replaced after `max_jobs_per_worker` jobs. That is the only thing that
+    clears the static state VerCors keeps between jobs in one JVM, so with the default of 1
+    every job runs in a fresh JVM. The replacement is started as soon as a job is done,
+    which hides the JVM start-up behind the other jobs. Larger values also reuse the JIT
+    warm-up, but then a job can observe state left by an earlier job of its worker."""
+
+    def __init__(self, command, jobs, max_jobs_per_worker, job_timeout):
+        self.command = command
+        self.max_jobs_per_worker = max_jobs_per_worker
+        self.job_timeout = job_timeout
+        self.idle = queue.Queue()
+        for _ in range(jobs):
+            self.idle.put(Worker(command))
+
+    def run(self, args):
+        worker = self.idle.get()
+        try:
+            if worker is None or not worker.alive():
+                worker = Worker(self.command)
+            job_dir = tempfile.mkdtemp(prefix="vct-job-")
+            try:
+                result = worker.run(args, job_dir, self.job_timeout)
+            finally:
+                shutil.rmtree(job_dir, ignore_errors=True)
+            # Replace workers so state VerCors keeps between jobs does not leak into later jobs
+            if not worker.alive() or worker.jobs >= self.max_jobs_per_worker:
+                worker.stop()
+                worker = Worker(self.command)
+            return result
+        except Exception:
+            if worker is not None:
+                worker.stop()
+            worker = None
+            raise
+        finally:
+            self.idle.put(worker)
+
+    def stop(self):
+        while not self.idle.empty():
+            worker = self.idle.get()
+            if worker is not None:
+                worker.stop()
+
+class RequestHandler(socketserver.StreamRequestHandler):
+    def handle(self):
+        request = json.loads(self.rfile.readline().decode())
+        try:
+            return_code, stdout, stderr = self.server.pool.run(request["args"])
+        except Exception as e:
+            return_code, stdout, stderr = 1, "", f"vct_server: {e}\n"
+        reply = {"return_code": return_code, "stdout": stdout, "stderr": stderr}
+        self.wfile.write((json.dumps(reply) + "\n").encode())
+
+class Server(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+def main():
+    parser = argparse.ArgumentParser(description='Keep VerCors JVMs warm and run vct jobs for vct_client.py')
+    parser.add_argument('--socket',
+                        default=default_socket_path(),
+                        help='Unix socket to listen on (default: $VCT_SERVER_SOCKET or /tmp/vct-server-<uid>.sock)')
+    parser.add_argument('--jobs',
+                        default=os.cpu_count(),
+                        type=int,
+                        help='Number of jobs that run concurrently, each in its own JVM (default: number of cores)')
+    parser.add_argument('--max-jobs-per-worker',
+                        default=1,
+                        type=int,
+                        help='Restart a JVM after this many jobs, which clears the state VerCors keeps '
+                             'between jobs. Values above 1 are faster, but jobs of one JVM are no longer '
+                             'isolated (default: 1)')
+    parser.add_argument('--job-timeout',
+                        default=4000,
+                        type=float,
+                        help='Kill and restart the JVM of a job that runs longer than this many seconds (default: 4000, '
+                             'above the --dev-total-timeout of 3600 the experiments pass to VerCors)')
+    parser.add_argument('--vct',
+                        default=VCT,
+                        help='vct script used to find the VerCors class path')
+    parser.add_argument('--classpath',
+                        default=os.environ.get("VCT_CLASSPATH"),
+                        help='VerCors class path (default: $VCT_CLASSPATH or taken from --vct)')
+    parser.add_argument('--jvm-option',
+                        action='append',
+                        default=["-Xss128m"],
+                        help='Extra option for the worker JVMs, can be repeated (default: -Xss128m)')
+
+    args = parser.parse_args()
+    assert args.jobs > 0 and args.max_jobs_per_worker > 0 and args.job_timeout > 0
+
+    build_dir = os.path.join(tempfile.gettempdir(), f"vct-server-{os.getuid()}")
+    compile_worker(build_dir)
+    classpath = args.classpath or discover_classpath(args.vct)
+    command = (["java", "-Djava.security.manager=allow"] + args.jvm_option
+               + ["-cp", build_dir + os.pathsep + classpath, WORKER_CLASS])
+
+    if os.path.exists(args.socket):
+        os.unlink(args.socket)
+    server = Server(args.socket, RequestHandler)
+    server.pool = WorkerPool(command, args.jobs, args.max_jobs_per_worker, args.job_timeout)
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+    print(f"Listening on {args.socket} with {args.jobs} workers")
+    sys.stdout.flush()
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.pool.stop()
+        server.server_close()
+        os.unlink(args.socket)
+
+if __name__ == "__main__":
+    main()
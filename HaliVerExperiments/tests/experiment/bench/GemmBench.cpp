@@ -0,0 +1,89 @@
+// Times the schedules of gemm_float and gemm_int8 (gemm_typed.h) with the Halide JIT and
+// compares their results with a plain C++ gemm.
+//   ./GemmBench [n] [repetitions]
+#include "gemm_typed.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Median time of repetitions calls of f, after one warm up call
+template<typename F>
+double time_ms(F f, int repetitions){
+    f();
+    std::vector<double> times;
+    for(int r = 0; r < repetitions; r++){
+        auto t0 = std::chrono::high_resolution_clock::now();
+        f();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+template<typename T, typename Acc>
+void bench(std::string label, int max_element, int n, int repetitions){
+    Buffer<T> A(n, n), B(n, n);
+    Buffer<Acc> C(n, n), reference(n, n);
+    std::mt19937 rng(42);
+    // Whole numbers, so the float sums do not depend on their order
+    int high = std::numeric_limits<T>::is_integer ? std::min<int>(max_element, std::numeric_limits<T>::max()) : max_element;
+    std::uniform_int_distribution<int> element(-max_element, high);
+    A.for_each_value([&](T &v){ v = (T) element(rng); });
+    B.for_each_value([&](T &v){ v = (T) element(rng); });
+    C.for_each_value([&](Acc &v){ v = (Acc) element(rng); });
+
+    double reference_ms = time_ms([&]{
+        std::vector<Acc> sum(n);
+        for(int j = 0; j < n; j++){
+            std::fill(sum.begin(), sum.end(), (Acc) 0);
+            for(int k = 0; k < n; k++){
+                Acc b = (Acc) B(k, j);
+                for(int i = 0; i < n; i++){
+                    sum[i] += (Acc) A(i, k) * b;
+                }
+            }
+            for(int i = 0; i < n; i++){
+                reference(i, j) = 2 * sum[i] + 3 * C(i, j);
+            }
+        }
+    }, 1);
+    printf("%-6s %-10s %12.3f\n", label.c_str(), "C++", reference_ms);
+
+    Target target = get_jit_target_from_environment()
+        .with_feature(Target::NoAsserts)
+        .with_feature(Target::NoBoundsQuery);
+    for(int schedule = 0; schedule <= 3; schedule++){
+        GemmTyped gemm(type_of<T>(), type_of<Acc>(), max_element, n, n, n);
+        gemm.schedule(schedule);
+        gemm.A_.set(A);
+        gemm.B_.set(B);
+        gemm.C_.set(C);
+        gemm.result_.compile_jit(target);
+
+        Buffer<Acc> out(n, n);
+        double ms = time_ms([&]{ gemm.result_.realize(out, target); }, repetitions);
+        double error = 0;
+        out.for_each_element([&](int i, int j){
+            error = std::max(error, std::abs((double) out(i, j) - (double) reference(i, j)));
+        });
+        printf("%-6s %-10s %12.3f %12.3g\n", label.c_str(), ("schedule " + std::to_string(schedule)).c_str(),
+            ms, error);
+    }
+}
+
+int main(int argc, char **argv){
+    int n = argc > 1 ? std::stoi(argv[1]) : 512;
+    int repetitions = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    printf("%d x %d matrices, median of %d runs\n", n, n, repetitions);
+    printf("%-6s %-10s %12s %12s\n", "", "", "ms", "max. error");
+    bench<float, float>("float", 1, n, repetitions);
+    bench<int8_t, int32_t>("int8", 128, n, repetitions);
+    return 0;
+}
@@ -9,7 +9,7 @@ int main(int argc, char *argv[]) {
   int schedule; 
   bool only_memory, front, non_unique;
   std::string name;
-  int res = read_args(argc, argv, schedule, only_memory, front, non_unique, name);
+  int res = read_args(argc, argv, schedule, only_memory, front, non_unique, name, 5);
   if(res != 0) return res;
 
   create_pipeline(name, schedule, front, only_memory, non_unique);
@@ -85,6 +85,77 @@ void create_pipeline(std::string name, int schedule, bool front, bool only_memor
       .unroll(y)
       .unroll(r.x, 2, TailStrategy::GuardWithIf)
       ;
+  /* Schedule 4 */
+  } else if(schedule == 4) {
+    // Blocks of 2 * vec channels and tile_h columns of relu, whose sums stay in
+    // 2 * tile_h vector registers. The input channels are summed in blocks of
+    // block_ci, for which the filter block of 2 * vec * 3 * 3 * block_ci values fits in L1.
+    const int block_ci = 32;
+    RVar rxo("rxo"), rxi("rxi");
+    relu.split(c, co, ci, vec * tile_w, TailStrategy::GuardWithIf)
+      .split(x, xo, xi, tile_h, TailStrategy::GuardWithIf)
+      .reorder(ci, xi, xo, y, n, co)
+      .vectorize(ci, vec)
+      .unroll(ci)
+      .unroll(xi)
+      .parallel(y)
+      .parallel(n)
+      .parallel(co);
+    conv.compute_at(relu, xo)
+      .vectorize(c, vec)
+      .unroll(c)
+      .unroll(x)
+      .unroll(y)
+      .update()
+      .split(r.x, rxo, rxi, block_ci, TailStrategy::GuardWithIf)
+      .reorder(c, x, y, rxi, r.y, r.z, rxo, n)
+      .vectorize(c, vec)
+      .unroll(c)
+      .unroll(x)
+      .unroll(y)
+      .unroll(rxi, 2, TailStrategy::GuardWithIf)
+      ;
+    // Copy of the filter read by conv, computed per block of input channels
+    Func filter_block = filter.in(conv);
+    std::vector<Var> fb = filter_block.args();
+    filter_block.ensures(filter_block(fb) >= 0);
+    filter_block.compute_at(conv, rxo)
+      .vectorize(fb[0], vec)
+      .unroll(fb[0])
+      ;
+  /* Schedule 5 */
+  } else if(schedule == 5) {
+    // Schedule 4 without vectorize: blocks of tile_c channels and tile_h columns of relu,
+    // whose tile_c * tile_h sums are unrolled into scalars.
+    const int tile_c = 4;
+    const int block_ci = 32;
+    RVar rxo("rxo"), rxi("rxi");
+    relu.split(c, co, ci, tile_c, TailStrategy::GuardWithIf)
+      .split(x, xo, xi, tile_h, TailStrategy::GuardWithIf)
+      .reorder(ci, xi, xo, y, n, co)
+      .unroll(ci)
+      .unroll(xi)
+      .parallel(y)
+      .parallel(n)
+      .parallel(co);
+    conv.compute_at(relu, xo)
+      .unroll(c)
+      .unroll(x)
+      .unroll(y)
+      .update()
+      .split(r.x, rxo, rxi, block_ci, TailStrategy::GuardWithIf)
+      .reorder(c, x, y, rxi, r.y, r.z, rxo, n)
+      .unroll(c)
+      .unroll(x)
+      .unroll(y)
+      .unroll(rxi, 2, TailStrategy::GuardWithIf)
+      ;
+    Func filter_block = filter.in(conv);
+    std::vector<Var> fb = filter_block.args();
+    filter_block.ensures(filter_block(fb) >= 0);
+    filter_block.compute_at(conv, rxo)
+      .unroll(fb[0])
+      ;
   }
   /* End Schedule */
   
@@ -0,0 +1,155 @@
+#include "Halide.h"
+#include "helper.h"
+#include <stdio.h>
+
+using namespace Halide;
+void create_pipeline(std::string name, int schedule, bool front, bool only_memory, bool non_unique);
+
+int main(int argc, char *argv[]) {
+  int schedule;
+  bool only_memory, front, non_unique;
+  std::string name;
+  int res = read_args(argc, argv, schedule, only_memory, front, non_unique, name, 3);
+  if(res != 0) return res;
+
+  create_pipeline(name, schedule, front, only_memory, non_unique);
+}
+
+// Two layers of conv_layer.cpp with a 2x2 max pool in between:
+//   conv1 + bias1 -> relu1 -> pool -> conv2 + bias2 -> relu2
+void create_pipeline(std::string name, int schedule, bool front, bool only_memory, bool non_unique){
+
+  /* Halide algorithm */
+  const int N = 4, CI = 16, C1 = 32, C2 = 32, W = 32, H = 32;
+  // Bounds of the inputs, the weights and the biases
+  const int max_input = 255, max_weight = 8, max_bias = 1 << 16;
+  // Bounds of the layers, max2 < 2^31 so conv2 does not overflow
+  const int max1 = max_bias + CI * 3 * 3 * max_weight * max_input;
+  const int max2 = max_bias + C1 * 3 * 3 * max_weight * max1;
+
+  ImageParam input(type_of<int>(), 4, "input");
+  ImageParam filter1(type_of<int>(), 4, "filter1");
+  ImageParam bias1(type_of<int>(), 1, "bias1");
+  ImageParam filter2(type_of<int>(), 4, "filter2");
+  ImageParam bias2(type_of<int>(), 1, "bias2");
+  Var x("x"), y("y"), c("c"), n("n");
+
+  input.requires(0 <= input(_) && input(_) <= max_input);
+  filter1.requires(-max_weight <= filter1(_) && filter1(_) <= max_weight);
+  bias1.requires(-max_bias <= bias1(_) && bias1(_) <= max_bias);
+  filter2.requires(-max_weight <= filter2(_) && filter2(_) <= max_weight);
+  bias2.requires(-max_bias <= bias2(_) && bias2(_) <= max_bias);
+
+  // Layer 1
+  Func conv1("conv1"), relu1("relu1");
+  RDom r1(0, CI, 0, 3, 0, 3, "r1");
+  // Number of products in the sum before iteration r1
+  Expr done1 = r1.x + CI * (r1.y + 3 * r1.z);
+  conv1(c, x, y, n) = bias1(c);
+  conv1.ensures(-max_bias <= conv1(c, x, y, n) && conv1(c, x, y, n) <= max_bias);
+  conv1(c, x, y, n) += filter1(c, r1.y, r1.z, r1.x) * input(r1.x, x + r1.y, y + r1.z, n);
+  conv1.invariant(-max_bias - done1 * max_weight * max_input <= conv1(c, x, y, n)
+    && conv1(c, x, y, n) <= max_bias + done1 * max_weight * max_input);
+  conv1.ensures(-max1 <= conv1(c, x, y, n) && conv1(c, x, y, n) <= max1);
+
+  relu1(c, x, y, n) = max(0, conv1(c, x, y, n));
+  relu1.ensures(0 <= relu1(c, x, y, n) && relu1(c, x, y, n) <= max1);
+
+  Func pool("pool");
+  pool(c, x, y, n) = max(max(relu1(c, 2*x, 2*y, n), relu1(c, 2*x + 1, 2*y, n)),
+                         max(relu1(c, 2*x, 2*y + 1, n), relu1(c, 2*x + 1, 2*y + 1, n)));
+  pool.ensures(0 <= pool(c, x, y, n) && pool(c, x, y, n) <= max1);
+
+  // Layer 2
+  Func conv2("conv2"), relu2("relu2");
+  RDom r2(0, C1, 0, 3, 0, 3, "r2");
+  Expr done2 = r2.x + C1 * (r2.y + 3 * r2.z);
+  conv2(c, x, y, n) = bias2(c);
+  conv2.ensures(-max_bias <= conv2(c, x, y, n) && conv2(c, x, y, n) <= max_bias);
+  conv2(c, x, y, n) += filter2(c, r2.y, r2.z, r2.x) * pool(r2.x, x + r2.y, y + r2.z, n);
+  conv2.invariant(-max_bias - done2 * max_weight * max1 <= conv2(c, x, y, n)
+    && conv2(c, x, y, n) <= max_bias + done2 * max_weight * max1);
+  conv2.ensures(-max2 <= conv2(c, x, y, n) && conv2(c, x, y, n) <= max2);
+
+  relu2(c, x, y, n) = max(0, conv2(c, x, y, n));
+  relu2.ensures(0 <= relu2(c, x, y, n) && relu2(c, x, y, n) <= max2);
+
+  /* Schedule */
+  const int vec = 8;
+  const int strip = 8;
+  Var yo("yo"), yi("yi");
+  /* Schedule 0 */
+  if(schedule == 0){
+
+  /* Schedule 1 */
+  } else if(schedule == 1) {
+    // One layer after the other, every layer stored in memory
+    conv1.compute_root()
+      .parallel(y)
+      ;
+    pool.compute_root()
+      .parallel(y)
+      ;
+    conv2.compute_root()
+      .parallel(y)
+      ;
+    relu2.parallel(y)
+      ;
+  /* Schedule 2 */
+  } else if(schedule == 2) {
+    // Strips of strip rows of relu2 in parallel. The pool of a strip is kept, and conv1 is
+    // computed per row of pool, so the activations stay in cache.
+    relu2.split(y, yo, yi, strip, TailStrategy::GuardWithIf)
+      .vectorize(c, vec)
+      .parallel(yo)
+      .parallel(n)
+      ;
+    conv2.compute_at(relu2, x)
+      .vectorize(c, vec)
+      .update()
+      .reorder(c, r2.x, r2.y, r2.z, x, y, n)
+      .vectorize(c, vec)
+      ;
+    pool.compute_at(relu2, yo)
+      .vectorize(c, vec)
+      ;
+    conv1.compute_at(pool, y)
+      .vectorize(c, vec)
+      .update()
+      .reorder(c, r1.x, r1.y, r1.z, x, y, n)
+      .vectorize(c, vec)
+      ;
+  /* Schedule 3 */
+  } else if(schedule == 3) {
+    // Schedule 2 without vectorize
+    relu2.split(y, yo, yi, strip, TailStrategy::GuardWithIf)
+      .parallel(yo)
+      .parallel(n)
+      ;
+    conv2.compute_at(relu2, x)
+      .update()
+      .reorder(c, r2.x, r2.y, r2.z, x, y, n)
+      ;
+    pool.compute_at(relu2, yo);
+    conv1.compute_at(pool, y)
+      .update()
+      .reorder(c, r1.x, r1.y, r1.z, x, y, n)
+      ;
+  }
+  /* End Schedule */
+
+  // Bounding the dimensions
+  set_bounds({{0, C2}, {0, W}, {0, H}, {0, N}}, relu2.output_buffer());
+  set_bounds({{0, CI}, {0, 2 * (W + 2) + 2}, {0, 2 * (H + 2) + 2}, {0, N}}, input);
+  set_bounds({{0, C1}, {0, 3}, {0, 3}, {0, CI}}, filter1);
+  set_bounds({{0, C1}}, bias1);
+  set_bounds({{0, C2}, {0, 3}, {0, 3}, {0, C1}}, filter2);
+  set_bounds({{0, C2}}, bias2);
+
+  Target new_target = standard_target();
+  if(front) {
+    relu2.translate_to_pvl(name + ".pvl", {}, {});
+  } else {
+    relu2.compile_to_c(name + ".c" , {input, filter1, bias1, filter2, bias2}, {}, name, new_target, only_memory, !non_unique);
+  }
+}
@@ -0,0 +1,15 @@
+#include "gemm_typed.h"
+#include <stdio.h>
+
+int main(int argc, char *argv[]) {
+  int schedule;
+  bool only_memory, front, non_unique;
+  std::string name;
+  int res = read_args(argc, argv, schedule, only_memory, front, non_unique, name, 3);
+  if(res != 0) return res;
+
+  // Gemm of float32 matrices with elements in [-1, 1]
+  GemmTyped gemm(Float(32), Float(32), 1.0f, 2048, 2048, 1024);
+  gemm.schedule(schedule);
+  gemm.compile(name, front, only_memory, non_unique);
+}
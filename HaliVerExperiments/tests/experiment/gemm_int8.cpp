@@ -0,0 +1,16 @@
+#include "gemm_typed.h"
+#include <stdio.h>
+
+int main(int argc, char *argv[]) {
+  int schedule;
+  bool only_memory, front, non_unique;
+  std::string name;
+  int res = read_args(argc, argv, schedule, only_memory, front, non_unique, name, 3);
+  if(res != 0) return res;
+
+  // Gemm of quantized int8 matrices, summed in int32. A sum of 1024 products of at most
+  // 128 * 128 is at most 2^24, so 2 * AB + 3 * C_ fits in int32
+  GemmTyped gemm(Int(8), Int(32), 128, 2048, 2048, 1024);
+  gemm.schedule(schedule);
+  gemm.compile(name, front, only_memory, non_unique);
+}
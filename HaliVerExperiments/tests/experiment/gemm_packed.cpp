@@ -0,0 +1,178 @@
+#include "Halide.h"
+#include "helper.h"
+#include <stdio.h>
+
+using namespace Halide;
+void create_pipeline(std::string name, int schedule, bool front, bool only_memory, bool non_unique);
+
+int main(int argc, char *argv[]) {
+  int schedule;
+  bool only_memory, front, non_unique;
+  std::string name;
+  int res = read_args(argc, argv, schedule, only_memory, front, non_unique, name, 3);
+  if(res != 0) return res;
+
+  create_pipeline(name, schedule, front, only_memory, non_unique);
+}
+
+// Gemm of gemm.cpp, with A and B packed into panels in the order the micro-kernel reads them.
+void create_pipeline(std::string name, int schedule, bool front, bool only_memory, bool non_unique){
+
+  const int num_rows = 2048;
+  const int num_cols = 2048;
+  const int sum_size = 1024;
+  const int a_ = 2;
+  const int b_ = 3;
+  const int vec = 4;
+  // Micro-kernel: an mr x nr tile of AB, kept in 2 * nr vector registers
+  const int mr = vec * 2;
+  const int nr = 4;
+  // Blocks of the result, made of micro-tiles
+  const int mc = 8 * mr;
+  const int nc = 32 * nr;
+  // Slices of the reduction: the mc x kc and kc x nc panels of one slice are packed together
+  const int kc = 256;
+
+  /* Halide algorithm */
+  ImageParam A_(type_of<int>(), 2, "A_");
+  ImageParam B_(type_of<int>(), 2, "B_");
+  ImageParam C_(type_of<int>(), 2, "C_");
+
+  Var i("i"), j("j"), k("k"), ii("ii"), ji("ji"), io("io"), jo("jo"), t("t");
+
+  Func A("A"), B("B"), Apack("Apack"), Bpack("Bpack"), result_("_result");
+  // Gemm
+  A_.requires(0 <= A_(_0, _1) && A_(_0, _1) < 100);
+  B_.requires(0 <= B_(_0, _1) && B_(_0, _1) < 100);
+  C_.requires(0 <= C_(_0, _1) && C_(_0, _1) < 100);
+
+  // Panels of mr rows of A, with the rows of a panel next to each other per k
+  Apack(ii, k, io) = A_(io * mr + ii, k);
+  Apack.ensures(Apack(ii, k, io) == A_(io * mr + ii, k));
+  A(i, k) = Apack(i % mr, k, i / mr);
+  A.ensures(implies(i >= 0 && i < num_rows && k >= 0 && k < sum_size,
+    A(i, k) == A_(i, k)));
+
+  // Panels of nr columns of B, with the columns of a panel next to each other per k
+  Bpack(ji, k, jo) = B_(k, jo * nr + ji);
+  Bpack.ensures(Bpack(ji, k, jo) == B_(k, jo * nr + ji));
+  B(k, j) = Bpack(j % nr, k, j / nr);
+  B.ensures(implies(k >= 0 && k < sum_size && j >= 0 && j < num_cols,
+    B(k, j) == B_(k, j)));
+
+  Func prod("prod");
+  prod(k, i, j) = A(i, k) * B(k, j);
+  prod.ensures(0 <= prod(k, i, j) && prod(k, i, j) < 100*100);
+
+  Func AB("AB");
+  AB(i, j) = 0;
+  AB.ensures(AB(i,j) == 0);
+  RDom rv(0, sum_size);
+  AB(i, j) += prod(rv, i, j);
+  AB.invariant(AB(i,j) >= 0 && AB(i,j) <= rv * 100 * 100);
+  AB.ensures(AB(i,j) >= 0 && AB(i,j) <= sum_size * 100 * 100);
+
+  result_(i, j) = (a_ * AB(i, j) + b_ * C_(i, j));
+  result_.ensures(result_(i, j) >= 0);
+  result_.ensures(result_(i, j) <= sum_size * 100 * 100 * a_ + b_ * 100);
+
+  // Bounding the dimensions
+  set_bounds({{0, num_rows}, {0, sum_size}}, A_);
+  set_bounds({{0, sum_size}, {0, num_cols}}, B_);
+  set_bounds({{0, num_rows}, {0, num_cols}}, C_);
+  set_bounds({{0, num_rows}, {0, num_cols}}, result_.output_buffer());
+
+  /* Schedule 0 */
+  if(schedule == 0){
+  /* Schedule 1 */
+  } else if(schedule == 1) {
+    // Packed once, micro-tiles of the result in parallel
+    Apack.compute_root()
+      .parallel(io)
+      ;
+    Bpack.compute_root()
+      .parallel(jo)
+      ;
+
+    result_
+      .tile(i, j, io, jo, i, j, mr, nr, TailStrategy::GuardWithIf)
+      .fuse(io, jo, t)
+      .parallel(t)
+      ;
+    AB.compute_at(result_, t)
+      .bound_extent(i, mr)
+      .bound_extent(j, nr)
+      ;
+  /* Schedule 2 */
+  } else if(schedule == 2) {
+    // Packed once, blocks of mc x nc of the result in parallel, split into micro-tiles
+    Apack.compute_root()
+      .unroll(ii)
+      .parallel(io)
+      ;
+    Bpack.compute_root()
+      .unroll(ji)
+      .parallel(jo)
+      ;
+
+    Var tio("tio"), tjo("tjo");
+    result_
+      .tile(i, j, tio, tjo, i, j, mc, nc, TailStrategy::GuardWithIf)
+      .tile(i, j, io, jo, i, j, mr, nr, TailStrategy::GuardWithIf)
+      .reorder(i, j, io, jo, tio, tjo)
+      .vectorize(i, vec)
+      .parallel(tjo)
+      ;
+
+    // The accumulators of the micro-tile stay in registers for the whole reduction
+    AB.compute_at(result_, io)
+      .bound_extent(i, mr)
+      .bound_extent(j, nr)
+      .vectorize(i, vec)
+      .unroll(j)
+      .update()
+      .reorder(i, j, rv)
+      .vectorize(i, vec)
+      .unroll(i)
+      .unroll(j)
+      ;
+  /* Schedule 3 */
+  } else if(schedule == 3) {
+    // Blocks of mc x nc of the result in parallel. The reduction runs in slices of kc,
+    // for each slice the panels of the block are packed and then every micro-tile of the
+    // block adds the slice to its mr x nr accumulators, unrolled without vectorize.
+    Var tio("tio"), tjo("tjo"), mio("mio"), mjo("mjo");
+    RVar rvo("rvo"), rvi("rvi");
+    result_
+      .tile(i, j, tio, tjo, i, j, mc, nc, TailStrategy::GuardWithIf)
+      .parallel(tjo)
+      ;
+
+    AB.compute_at(result_, tio)
+      .bound_extent(i, mc)
+      .bound_extent(j, nc)
+      .update()
+      .split(rv, rvo, rvi, kc, TailStrategy::GuardWithIf)
+      .tile(i, j, mio, mjo, i, j, mr, nr, TailStrategy::GuardWithIf)
+      .reorder(i, j, rvi, mio, mjo, rvo)
+      .unroll(i)
+      .unroll(j)
+      ;
+
+    Apack.compute_at(AB, rvo)
+      .unroll(ii)
+      ;
+    Bpack.compute_at(AB, rvo)
+      .unroll(ji)
+      ;
+  }
+  /* End Schedule */
+
+  Target new_target = standard_target();
+
+  if(front) {
+      result_.translate_to_pvl(name + ".pvl", {}, {});
+  } else {
+      result_.compile_to_c(name + ".c" , {A_, B_, C_}, {}, name, new_target, only_memory, !non_unique);
+  }
+}
@@ -0,0 +1,130 @@
+// The gemm of gemm.cpp for other element types, used by gemm_float.cpp, gemm_int8.cpp and
+// bench/GemmBench.cpp. The elements of A_ and B_ are of type `type` in [-max_element, max_element],
+// their products and sums are of type `acc`. The contracts bound the sums, so for an integer
+// `acc` they show that the accumulation does not overflow.
+#include "Halide.h"
+#include "helper.h"
+
+using namespace Halide;
+
+struct GemmTyped {
+  ImageParam A_, B_, C_;
+  Func prod, AB, result_;
+  Var i, j, k;
+  RDom rv;
+  int num_rows, num_cols, sum_size;
+
+  GemmTyped(Type type, Type acc, Expr max_element, int num_rows, int num_cols, int sum_size) :
+    A_(type, 2, "A_"), B_(type, 2, "B_"), C_(acc, 2, "C_"),
+    prod("prod"), AB("AB"), result_("_result"),
+    i("i"), j("j"), k("k"),
+    rv(0, sum_size),
+    num_rows(num_rows), num_cols(num_cols), sum_size(sum_size) {
+
+    // Compared in acc, so max_element does not need to fit in type
+    Expr m = cast(acc, max_element);
+    // Largest product and largest sum
+    Expr max_prod = m * m;
+    Expr max_sum = max_prod * sum_size;
+    Expr a_ = cast(acc, 2);
+    Expr b_ = cast(acc, 3);
+
+    /* Halide algorithm */
+    A_.requires(-m <= cast(acc, A_(_0, _1)) && cast(acc, A_(_0, _1)) <= m);
+    B_.requires(-m <= cast(acc, B_(_0, _1)) && cast(acc, B_(_0, _1)) <= m);
+    C_.requires(-max_sum <= C_(_0, _1) && C_(_0, _1) <= max_sum);
+
+    prod(k, i, j) = cast(acc, A_(i, k)) * cast(acc, B_(k, j));
+    prod.ensures(-max_prod <= prod(k, i, j) && prod(k, i, j) <= max_prod);
+
+    AB(i, j) = cast(acc, 0);
+    AB.ensures(AB(i, j) == cast(acc, 0));
+    AB(i, j) += prod(rv, i, j);
+    AB.invariant(-max_prod * rv <= AB(i, j) && AB(i, j) <= max_prod * rv);
+    AB.ensures(-max_sum <= AB(i, j) && AB(i, j) <= max_sum);
+
+    result_(i, j) = a_ * AB(i, j) + b_ * C_(i, j);
+    result_.ensures(-(a_ + b_) * max_sum <= result_(i, j) && result_(i, j) <= (a_ + b_) * max_sum);
+
+    // Bounding the dimensions
+    set_bounds({{0, num_rows}, {0, sum_size}}, A_);
+    set_bounds({{0, sum_size}, {0, num_cols}}, B_);
+    set_bounds({{0, num_rows}, {0, num_cols}}, C_);
+    set_bounds({{0, num_rows}, {0, num_cols}}, result_.output_buffer());
+  }
+
+  // Schedules 0 up to and including 3 are valid
+  void schedule(int schedule){
+    const int vec = 8;
+    const int mr = vec * 2;
+    const int nr = 4;
+    // Tile of the scalar schedule 3, small enough for its sums to stay in registers
+    const int sr = 4;
+    Var io("io"), jo("jo"), t("t");
+
+    /* Schedule 0 */
+    if(schedule == 0){
+    /* Schedule 1 */
+    } else if(schedule == 1) {
+      // Tiles of the result in parallel
+      result_
+        .tile(i, j, io, jo, i, j, mr, nr, TailStrategy::GuardWithIf)
+        .fuse(io, jo, t)
+        .parallel(t)
+        ;
+      AB.compute_at(result_, t)
+        .bound_extent(i, mr)
+        .bound_extent(j, nr)
+        ;
+    /* Schedule 2 */
+    } else if(schedule == 2) {
+      // Schedule 1, with the sums of a tile in 2 * nr vector registers
+      result_
+        .tile(i, j, io, jo, i, j, mr, nr, TailStrategy::GuardWithIf)
+        .fuse(io, jo, t)
+        .parallel(t)
+        .vectorize(i, vec)
+        ;
+      AB.compute_at(result_, t)
+        .bound_extent(i, mr)
+        .bound_extent(j, nr)
+        .vectorize(i, vec)
+        .unroll(j)
+        .update()
+        .reorder(i, j, rv)
+        .vectorize(i, vec)
+        .unroll(i)
+        .unroll(j)
+        ;
+    /* Schedule 3 */
+    } else if(schedule == 3) {
+      // Schedule 2 without vectorize, on tiles of sr x sr with their sums unrolled
+      result_
+        .tile(i, j, io, jo, i, j, sr, sr, TailStrategy::GuardWithIf)
+        .fuse(io, jo, t)
+        .parallel(t)
+        ;
+      AB.compute_at(result_, t)
+        .bound_extent(i, sr)
+        .bound_extent(j, sr)
+        .unroll(i)
+        .unroll(j)
+        .update()
+        .reorder(i, j, rv)
+        .unroll(i)
+        .unroll(j)
+        ;
+    }
+    /* End Schedule */
+  }
+
+  void compile(std::string name, bool front, bool only_memory, bool non_unique){
+    Target new_target = standard_target();
+
+    if(front) {
+        result_.translate_to_pvl(name + ".pvl", {}, {});
+    } else {
+        result_.compile_to_c(name + ".c" , {A_, B_, C_}, {}, name, new_target, only_memory, !non_unique);
+    }
+  }
+};
@@ -2,7 +2,9 @@
 #include <vector>
 #include <string>
 
-int read_args(int argc, char** argv, int& schedule, bool& only_memory, bool& front, bool& non_unique, std::string& name){
+// Schedules 0 up to and including max_schedule are valid
+int read_args(int argc, char** argv, int& schedule, bool& only_memory, bool& front, bool& non_unique, std::string& name,
+    int max_schedule = 3){
     only_memory = false;
     front = false;
     non_unique = false;
@@ -36,7 +38,7 @@ int read_args(int argc, char** argv, int& schedule, bool& only_memory, bool& fro
             return 1;
         }
     }
-    if(prev_was_schedule || (front && schedule != 0) || (!front && !(0 <= schedule && schedule <= 3))){
+    if(prev_was_schedule || (front && schedule != 0) || (!front && !(0 <= schedule && schedule <= max_schedule))){
         printf("Invallid argument\n");
         return 1;
     }
@@ -0,0 +1,366 @@
+#pragma once
+// The algorithm of the diagonal solver, shared by GenerateHalideDiagonal and GenerateHalideBatched.
+// Every buffer and Func is indexed by its own dimensions followed by the batch dimensions:
+// none for GenerateHalideDiagonal, the channel block cb for GenerateHalideBatched. The
+// generators add their schedules to the Funcs defined here.
+#include "Halide.h"
+#include "HalideComplex.h"
+#include "PadreOptions.h"
+#include <math.h>
+
+using namespace Halide;
+
+class DiagonalAlgorithm{
+public:
+    // Inputs
+    ImageParam ant1;
+    ImageParam ant2;
+    ImageParam solution_map;
+    ImageParam v_res_in;
+    ImageParam model_;
+    ImageParam sol_;
+    ImageParam next_sol_;
+    Param<int> solution_index0;
+#ifdef CONCRETE_BOUNDS
+    Expr n_dir_sol;
+    Expr n_solutions;
+    Expr n_vis;
+    Expr n_antennas;
+#else
+    Param<int> n_dir_sol;
+    Param<int> n_solutions;
+    Param<int> n_vis;
+    Param<int> n_antennas;
+#endif
+    Param<double> step_size;
+    Param<bool> phase_only;
+
+    Func model, solutions, solD, next_sol;
+    Var x, y, i, j, v, si, a, pol, c;
+
+    Func antenna_1, antenna_2, solution_index, v_res0;
+
+    // Funcs of SolveDirection, defined by SolveDirectionAlgorithm
+    Func cor_model_transp_1, cor_model_2;
+    Func ant_i;
+    Func denominator_inter, numerator_inter;
+    Func numerator, denominator;
+    RDom rv2;
+
+    PadreOptions options;
+    // The batch dimensions and their extents
+    std::vector<Var> batch;
+    std::vector<Expr> batch_extents;
+
+    DiagonalAlgorithm(PadreOptions options, std::vector<Var> batch) :
+        ant1(type_of<int32_t>(), 1 + batch.size(), "ant1"), // <1>[n_ant] uint32_t
+        ant2(type_of<int32_t>(), 1 + batch.size(), "ant2"), // <1>[n_ant] uint32_t
+        solution_map(type_of<int32_t>(), 1 + batch.size(), "solution_map"), // <1>[n_vis] uint32_t
+        v_res_in(type_of<float>(), 4 + batch.size(), "v_res_in"), // <4>[n_vis], Complex 2x2 Float (+3)
+
+        model_(type_of<float>(), 4 + batch.size(), "model_"), // <4>[n_vis], Complex 2x2 Float (+3)
+        sol_(type_of<double>(), 4 + batch.size(), "sol_"), // <4> [n_ant][n_dir_sol][2] Complex Double (+1)
+        next_sol_(type_of<double>(), 4 + batch.size(), "next_sol_"), // <4> [n_ant][n_dir_sol][2] Complex Double (+1)
+        solution_index0("solution_index0"),
+#ifndef CONCRETE_BOUNDS
+        n_dir_sol("n_dir_sol"),
+        n_solutions("n_solutions"),
+        n_vis("n_vis"),
+        n_antennas("n_antennas"),
+#endif
+        step_size("step_size"),
+        phase_only("phase_only"),
+        model("model"), solutions("solutions"), solD("solD"), next_sol("next_sol"),
+        x("x"), y("y"), i("i"), j("j"), v("v"), si("si"), a("a"), pol("pol"), c("c"),
+        antenna_1("antenna_1"), antenna_2("antenna_2"), solution_index("solution_index"),
+        v_res0("v_res0"),
+        cor_model_transp_1("cor_model_transp_1"), cor_model_2("cor_model_2"),
+        ant_i("ant_i"),
+        denominator_inter("denominator_inter"), numerator_inter("numerator_inter"),
+        numerator("numerator"), denominator("denominator"),
+        options(options), batch(batch){
+
+#ifdef CONCRETE_BOUNDS
+        // solution_index0 = 0;
+        n_dir_sol = 3;
+        n_solutions = 8;
+        n_vis = 230930;
+        n_antennas = 50;
+#endif
+    }
+
+    // Defines the inputs for batch dimensions with the given extents, called by the
+    // constructor of the generator once the extents exist.
+    void define(std::vector<Expr> extents){
+        batch_extents = extents;
+
+        set_bounds(bounds({{0, n_vis}}), ant1);
+        set_bounds(bounds({{0, n_vis}}), ant2);
+        set_bounds(bounds({{0, n_vis}}), solution_map);
+        set_complex_bounds(bounds({{0, 2}, {0, 2}, {0, 2}, {0, n_vis}}), v_res_in, options.split_complex, 3);
+        set_complex_bounds(bounds({{0, 2}, {0, 2}, {0, 2}, {0, n_vis}}), model_, options.split_complex, 3);
+        set_bounds(bounds({{0, 2}, {0, 2}, {0, n_solutions}, {0, n_antennas}}), sol_);
+        set_bounds(bounds({{0, 2}, {0, 2}, {0, n_solutions}, {0, n_antennas}}), next_sol_);
+
+        model(vars({v})) = toComplexMatrix(model_, at({v}));
+        solD(vars({i, si, a})) = Tuple(sol_(at({0, i, si, a})), sol_(at({1, i, si, a})));
+        next_sol(vars({i, si, a})) = Tuple(next_sol_(at({0, i, si, a})), next_sol_(at({1, i, si, a})));
+
+        antenna_1(vars({v})) = unsafe_promise_clamped(cast<int>(ant1(at({v}))), 0, n_antennas-1);
+        antenna_2(vars({v})) = unsafe_promise_clamped(cast<int>(ant2(at({v}))), 0, n_antennas-1);
+        solution_index(vars({v})) = unsafe_promise_clamped(cast<int>(solution_map(at({v}))),
+            solution_index0, solution_index0+n_dir_sol-1);
+
+        solutions(vars({si, a})) = toDiagMatrix(solD, at({si, a}));
+
+        v_res0(vars({v})) = toComplexMatrix(v_res_in, at({v}));
+    }
+
+    template<typename T>
+    std::vector<T> concat(std::vector<T> a, std::vector<T> b){
+        std::vector<T> out;
+        out.reserve(a.size() + b.size());
+        out.insert(out.end(), a.begin(), a.end());
+        out.insert(out.end(), b.begin(), b.end());
+        return out;
+    }
+
+    // The arguments followed by the batch dimensions
+    std::vector<Var> vars(std::vector<Var> args){
+        return concat(args, batch);
+    }
+
+    std::vector<Expr> at(std::vector<Expr> args){
+        return concat(args, std::vector<Expr>(batch.begin(), batch.end()));
+    }
+
+    // The bounds followed by the bounds of the batch dimensions
+    std::vector<std::tuple<Expr, Expr>> bounds(std::vector<std::tuple<Expr, Expr>> dims){
+        for(Expr extent : batch_extents){
+            dims.push_back({0, extent});
+        }
+        return dims;
+    }
+
+    // Bounds the batch dimensions of f
+    void bound_batch(Func f){
+        for(size_t b = 0; b < batch.size(); b++){
+            f.bound(batch[b], 0, batch_extents[b]);
+        }
+    }
+
+    // Makes a function for which 2 dimensions are matrix dimensions
+    // towards a function of Matrix type.
+    // E.g. f(i,j, ..args)
+    // -> f(..args) = Matrix(f(0,0, ..args), f(1,0, ..args),
+    //                       f(1,0, ..args), f(1,1, ..args))
+    Matrix toMatrix(Func f, std::vector<Expr> args){
+        Complex c1, c2, c3, c4;
+        c1 = f(concat({0,0}, args));
+        c2 = f(concat({1,0}, args));
+        c3 = f(concat({0,1}, args));
+        c4 = f(concat({1,1}, args));
+
+        return Matrix(c1, c2, c3, c4);
+    }
+
+    MatrixDiag toDiagMatrix(Func f, std::vector<Expr> args){
+        Complex c00, c11;
+        c00 = f(concat({0}, args));
+        c11 = f(concat({1}, args));
+
+        return MatrixDiag(c00, c11);
+    }
+
+    MatrixDiag toComplexDiagMatrix(Func f, std::vector<Expr> args){
+        Complex c00, c11;
+        c00 = Complex(f(concat({0,0}, args)), f(concat({1,0}, args)));
+        c11 = Complex(f(concat({0,1}, args)), f(concat({1,1}, args)));
+
+        return MatrixDiag(c00, c11);
+    }
+
+    Matrix toComplexMatrix(Func f, std::vector<Expr> args){
+        Complex c1, c2, c3, c4;
+        c1 = Complex(f(concat({0,0,0}, args)), f(concat({1,0,0}, args)));
+        c2 = Complex(f(concat({0,1,0}, args)), f(concat({1,1,0}, args)));
+        c3 = Complex(f(concat({0,0,1}, args)), f(concat({1,0,1}, args)));
+        c4 = Complex(f(concat({0,1,1}, args)), f(concat({1,1,1}, args)));
+
+        return Matrix(c1, c2, c3, c4);
+    }
+
+    Func matrixToDimensions(Func in, std::vector<Var> args){
+        Matrix m = Matrix(in(args));
+        Func v_res_out("v_res_out");
+
+        v_res_out(concat({c, i, j}, args)) = cast<float>(select(
+            c == 0 && i == 0 && j == 0, m.m00.real,
+            c == 1 && i == 0 && j == 0, m.m00.imag,
+            c == 0 && i == 1 && j == 0, m.m01.real,
+            c == 1 && i == 1 && j == 0, m.m01.imag,
+            c == 0 && i == 0 && j == 1, m.m10.real,
+            c == 1 && i == 0 && j == 1, m.m10.imag,
+            c == 0 && i == 1 && j == 1, m.m11.real,
+            m.m11.imag
+        ));
+        v_res_out.bound(c, 0, 2).bound(i, 0, 2).bound(j, 0, 2);
+
+        return v_res_out;
+    }
+
+    Func diagMatrixToDimensions(Func in, std::vector<Var> args){
+        MatrixDiag m = MatrixDiag(in(args));
+        Func v_res_out("v_res_out");
+
+        v_res_out(concat({c,i}, args)) = select(
+            c == 0 && i == 0, m.m00.real,
+            c == 1 && i == 0, m.m00.imag,
+            c == 0 && i == 1, m.m11.real,
+                              m.m11.imag
+        );
+        v_res_out.bound(c, 0, 2).bound(i, 0, 2);
+
+        return v_res_out;
+    }
+
+    Func AddOrSubtractDirection(bool add, Func vis_in){
+        Func vis_out("vis_out");
+        Type ct = compute_type(options.contribution);
+        Type acc = accumulate_type(options.contribution);
+
+        MatrixDiag solution_1 = castT(ct, solutions(at({solution_index(at({v})), antenna_1(at({v}))})));
+        MatrixDiag solution_2 = castT(ct, solutions(at({solution_index(at({v})), antenna_2(at({v}))})));
+
+        Matrix contribution = solution_1 * Matrix(castT(ct, model(at({v})))) * HermTranspose(solution_2);
+
+        if(add){
+            vis_out(vars({v})) = Matrix(castT(acc, vis_in(at({v})))) + Matrix(castT(acc, contribution));
+        } else {
+            vis_out(vars({v})) = Matrix(castT(acc, vis_in(at({v})))) - Matrix(castT(acc, contribution));
+        }
+
+        return vis_out;
+    }
+
+    // Defines the sums over the visibilities of SolveDirection and returns the new solutions.
+    Func SolveDirectionAlgorithm(Func vis_in){
+        Func next_solutions_inter("next_solutions_inter");
+        Func next_solutions("next_solutions");
+
+        Func vis_in_add = AddOrSubtractDirection(true, vis_in);
+        // Terms per visibility are computed in st, and summed in sa
+        Type st = compute_type(options.solve);
+        Type sa = accumulate_type(options.solve);
+
+        MatrixDiag solution_1 = castT(st, solutions(at({solution_index(at({v})), antenna_2(at({v}))})));
+        MatrixDiag solution_2 = castT(st, solutions(at({solution_index(at({v})), antenna_1(at({v}))})));
+        Matrix vis = castT(st, vis_in_add(at({v})));
+        cor_model_transp_1(vars({v})) = solution_1 * HermTranspose(Matrix(castT(st, model(at({v})))));
+        cor_model_2(vars({v})) = solution_2 * Matrix(castT(st, model(at({v}))));
+
+        numerator_inter(vars({a, v})) = {undef(st), undef(st), undef(st), undef(st)};
+        numerator_inter(at({0, v})) = Diagonal(vis * Matrix(cor_model_transp_1(at({v}))));
+        numerator_inter(at({1, v})) = Diagonal(HermTranspose(vis) * Matrix(cor_model_2(at({v}))));
+
+        Matrix m1 = Matrix(cor_model_transp_1(at({v})));
+        Matrix m2 = Matrix(cor_model_2(at({v})));
+        denominator_inter(vars({a, i, v})) = undef(st);
+        denominator_inter(at({0, 0, v})) = m1.m00.norm() + m1.m10.norm();
+        denominator_inter(at({0, 1, v})) = m1.m01.norm() + m1.m11.norm();
+        denominator_inter(at({1, 0, v})) = m2.m00.norm() + m2.m10.norm();
+        denominator_inter(at({1, 1, v})) = m2.m01.norm() + m2.m11.norm();
+
+        ant_i(vars({a, v})) = select(a == 0, antenna_1(at({v})), antenna_2(at({v})));
+        rv2 = RDom(0, 2, 0, n_vis, "rv2");
+        Expr zero = cast(sa, 0.0f);
+        Expr r_si = solution_index(at({rv2.y}));
+        Expr r_a = ant_i(at({rv2.x, rv2.y}));
+        numerator(vars({si, a})) = MatrixDiag({zero, zero, zero, zero});
+        numerator(at({r_si, r_a})) = MatrixDiag(numerator(at({r_si, r_a})))
+            + MatrixDiag(castT(sa, numerator_inter(at({rv2.x, rv2.y}))));
+        denominator(vars({i, si, a})) = zero;
+        denominator(at({i, r_si, r_a})) += cast(sa, denominator_inter(at({rv2.x, i, rv2.y})));
+
+        Expr nan = Expr(std::numeric_limits<double>::quiet_NaN());
+        Complex cnan = Complex(nan, nan);
+
+        next_solutions_inter(vars({pol, si, a})) = tuple_select(
+            denominator(at({pol, si, a})) == 0.0f, cnan,
+            pol == 0, Tuple(castC<double>(MatrixDiag(numerator(at({si, a}))).m00) / cast<double>(denominator(at({0, si, a})))),
+            castC<double>(MatrixDiag(numerator(at({si, a}))).m11) / cast<double>(denominator(at({1, si, a})))
+        );
+        next_solutions(vars({c, pol, si, a})) = mux(c,
+            {Complex(next_solutions_inter(at({pol, si, a}))).real,
+             Complex(next_solutions_inter(at({pol, si, a}))).imag});
+
+        next_solutions.bound(c,0,2).bound(pol, 0, 2).bound(a, 0, n_antennas).bound(si, solution_index0, n_dir_sol);
+        bound_batch(next_solutions);
+        set_bounds({{0, 2}, {0, 2}}, next_solutions.output_buffer());
+        next_solutions.output_buffer().dim(2).set_stride(2*2);
+        next_solutions.output_buffer().dim(2).set_bounds(solution_index0, n_dir_sol);
+        next_solutions.output_buffer().dim(3).set_stride(2*2*n_solutions);
+        next_solutions.output_buffer().dim(3).set_bounds(0, n_antennas);
+        Expr stride = 2*2*n_solutions*n_antennas;
+        for(size_t b = 0; b < batch.size(); b++){
+            next_solutions.output_buffer().dim(4 + b).set_stride(stride);
+            next_solutions.output_buffer().dim(4 + b).set_bounds(0, batch_extents[b]);
+            stride = stride * batch_extents[b];
+        }
+
+        return next_solutions;
+    }
+
+    // Subtracts the direction from the visibilities in v_sub_out, and returns it
+    // split into dimensions
+    Func SubDirectionAlgorithm(Func &v_sub_out){
+        v_sub_out = AddOrSubtractDirection(false, v_res0);
+        Func v_sub_out_matrix = matrixToDimensions(v_sub_out, vars({v}));
+        v_sub_out_matrix.bound(v, 0, n_vis);
+        bound_batch(v_sub_out_matrix);
+        set_complex_bounds(bounds({{0, 2}, {0, 2}, {0, 2}, {0, n_vis}}), v_sub_out_matrix.output_buffer(),
+            options.split_complex, 3);
+
+        return v_sub_out_matrix;
+    }
+
+    Func StepAlgorithm(){
+        Func next_solutions("next_solutions");
+        Func next_solutions_("next_solutions_0");
+        Expr pi = Expr(M_PI);
+        Func distance("distance");
+
+        Expr phase_from = arg(solD(at({i, si, a})));
+        distance(vars({i, si, a})) = phase_from - arg(next_sol(at({i, si, a})));
+        distance(vars({i, si, a})) = select(distance(at({i, si, a})) > pi,
+            distance(at({i, si, a})) - 2*pi, distance(at({i, si, a})) + 2*pi);
+        Complex phase_only_true = polar(Expr(1.0), phase_from + step_size * distance(at({i, si, a})));
+        Complex phase_only_false = Complex(solD(at({i, si, a}))) * (Expr(1.0) - step_size)
+            + Complex(next_sol(at({i, si, a}))) * Complex(step_size);
+
+        next_solutions_(vars({i, si, a})) = tuple_select(phase_only,
+           phase_only_true,
+           phase_only_false);
+        next_solutions(vars({c, i, si, a})) = mux(c,
+            {Complex(next_solutions_(at({i, si, a}))).real,
+             Complex(next_solutions_(at({i, si, a}))).imag});
+        next_solutions.bound(c,0,2).bound(i, 0, 2).bound(a, 0, n_antennas).bound(si, 0, n_solutions);
+        bound_batch(next_solutions);
+        set_bounds(bounds({{0, 2}, {0, 2}, {0, n_solutions}, {0, n_antennas}}), next_solutions.output_buffer());
+
+        return next_solutions;
+    }
+
+    // Context of SolveDirection and SubDirection
+    Expr solve_context(){
+        return solution_index0 >= 0 && n_dir_sol > 0
+            && solution_index0 + n_dir_sol < n_solutions
+            && n_antennas>0 && n_vis>0 && n_solutions>0;
+    }
+
+    // Context of Step, which is only verified for the sizes of the benchmark data
+    Expr step_context(){
+        return n_antennas>0 && n_vis>0 && n_solutions>0
+            && n_antennas == 50 && n_solutions == 8 && n_vis == 230930 && n_dir_sol ==3;
+    }
+};
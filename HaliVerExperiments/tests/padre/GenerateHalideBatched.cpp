@@ -0,0 +1,161 @@
+#include "Halide.h"
+#define HAVE_HALIVER
+// #define CONCRETE_BOUNDS
+#include "DiagonalAlgorithm.h"
+
+// Step, SubDirection and SolveDirection of GenerateHalideDiagonal over n_cb channel
+// blocks in one call, parallel over the channel blocks.
+using namespace Halide;
+
+class HalideBatchedSolver : public DiagonalAlgorithm{
+public:
+#ifdef CONCRETE_BOUNDS
+    Expr n_cb;
+#else
+    Param<int> n_cb;
+#endif
+    Var cb;
+    std::vector<Argument> args;
+
+    HalideBatchedSolver(PadreOptions options) :
+        DiagonalAlgorithm(options, {Var("cb")}),
+#ifndef CONCRETE_BOUNDS
+        n_cb("n_cb"),
+#endif
+        cb(batch[0]){
+
+#ifdef CONCRETE_BOUNDS
+        n_cb = 4;
+#endif
+
+        define({n_cb});
+#ifdef CONCRETE_BOUNDS
+        args = {sol_, solution_map, ant1, ant2, model_, v_res_in, solution_index0};
+#else
+        args = {sol_, solution_map, ant1, ant2, model_, v_res_in, solution_index0, n_dir_sol, n_vis, n_solutions, n_antennas, n_cb};
+#endif
+    }
+
+    Func SolveDirection(Func vis_in){
+        Func next_solutions = SolveDirectionAlgorithm(vis_in);
+
+        // Every channel block is solved on its own thread, with the sums over its
+        // visibilities as in schedule 1 of GenerateHalideDiagonal.
+        next_solutions.compute_root()
+            .unroll(pol)
+            .unroll(c)
+            .parallel(cb)
+            ;
+        denominator.compute_at(next_solutions, cb)
+            .update()
+            .reorder(i, rv2.x, rv2.y)
+            .unroll(i)
+            .unroll(rv2.x)
+            ;
+        numerator.compute_at(next_solutions, cb)
+            .update()
+            .unroll(rv2.x)
+            .compute_with(denominator.update(), rv2.y)
+            ;
+
+        return next_solutions;
+    }
+
+    Func SubDirection(){
+        Func v_sub_out;
+        Func v_sub_out_matrix = SubDirectionAlgorithm(v_sub_out);
+
+        v_sub_out_matrix
+            .reorder(c, i, j, v, cb)
+            .unroll(c)
+            .unroll(i)
+            .unroll(j)
+            .parallel(cb)
+            ;
+
+        return v_sub_out_matrix;
+    }
+
+    Func Step(){
+        Func next_solutions = StepAlgorithm();
+
+        next_solutions
+            .parallel(cb)
+            .specialize(phase_only)
+            .unroll(c)
+        ;
+
+        return next_solutions;
+    }
+
+    void compile(bool non_unique){
+        try{
+            Target target = get_target_from_environment();
+            target.set_features({Target::NoAsserts, Target::NoBoundsQuery});
+#ifdef CONCRETE_BOUNDS
+            std::vector<Argument> step_args = {phase_only, step_size, sol_, next_sol_};
+#else
+            std::vector<Argument> step_args = {n_vis, n_solutions, n_antennas, phase_only, step_size, sol_, next_sol_, n_dir_sol, n_cb};
+#endif
+
+            // Bounds on input
+            ant1.requires((ant1(_0, _1) >= 0 && ant1(_0, _1) < n_antennas));
+            ant2.requires((ant2(_0, _1) >= 0 && ant2(_0, _1) < n_antennas));
+            solution_map.requires((solution_map(_0, _1) >= solution_index0
+                && solution_map(_0, _1) < solution_index0+n_dir_sol));
+            Annotation bounds = context_everywhere(solve_context() && n_cb>0);
+            Annotation step_bounds = context_everywhere(step_context() && n_cb>0);
+#ifdef CONCRETE_BOUNDS
+            std::string cb = "CB";
+#else
+            std::string cb = "";
+#endif
+            std::string NU = non_unique ? "_non_unique" : "";
+            std::string postfix = cb + options.suffix + NU;
+
+            Func solve_out = SolveDirection(v_res0);
+            Func step_out = Step();
+            Func v_sub_out_matrix = SubDirection();
+
+            if(options.static_library){
+                // Linked with the runtime of the Diagonal libraries
+                target.set_feature(Target::NoRuntime);
+                solve_out.compile_to_static_library("SolveDirectionBatchedHalide" + postfix, args,
+                    "SolveDirectionBatched" + postfix, target);
+                step_out.compile_to_static_library("StepBatchedHalide" + postfix, step_args,
+                    "StepBatchedHalide" + postfix, target);
+                v_sub_out_matrix.compile_to_static_library("SubDirectionBatchedHalide" + postfix, args,
+                    "SubDirectionBatched" + postfix, target);
+                return;
+            }
+
+            solve_out.compile_to_c("SolveDirectionBatchedHalide" + postfix + ".c", args, {bounds},
+                "SolveDirectionBatched" + postfix, target, false, !non_unique);
+            step_out.compile_to_c("StepBatchedHalide" + postfix + ".c", step_args, {step_bounds},
+                "StepBatchedHalide" + postfix, target, false, !non_unique);
+            v_sub_out_matrix.compile_to_c("SubDirectionBatchedHalide" + postfix + ".c", args, {bounds},
+                "SubDirectionBatched" + postfix, target, false, !non_unique);
+        } catch (Halide::Error &e){
+            std::cerr << "Halide Error: " << e.what() << std::endl;
+            __throw_exception_again;
+        }
+    }
+};
+
+int main(int argc, char **argv){
+    PadreOptions options;
+    int res = read_padre_args(argc, argv, options);
+    if(res != 0) return res;
+    // The sums have the single schedule above, per channel block
+    if(options.schedule >= 0 || options.chunk > 0 || options.parts > 0){
+        printf("GenerateHalideBatched does not support schedule, chunk or parts\n");
+        return 1;
+    }
+
+    HalideBatchedSolver solver(options);
+    solver.compile(false);
+    if(options.static_library) return 0;
+
+    HalideBatchedSolver solver2(options);
+    solver2.compile(true);
+}
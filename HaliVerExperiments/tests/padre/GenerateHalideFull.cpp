@@ -1,5 +1,6 @@
 #include "Halide.h"
 #include "HalideComplex.h"
+#include "PadreOptions.h"
 #include <math.h>
 #define HAVE_HALIVER
 // #define CONCRETE_BOUNDS
@@ -15,15 +16,6 @@ std::vector<T> concat(std::vector<T> a, std::vector<T> b){
     return out;
 }
 
-void set_bounds(std::vector<std::tuple<Expr, Expr>> dims, Halide::OutputImageParam p){
-    Expr stride = 1;
-    for(size_t i = 0; i < dims.size(); i++){
-        p.dim(i).set_bounds(std::get<0>(dims[i]), std::get<1>(dims[i]));
-        p.dim(i).set_stride(stride);
-        stride *= std::get<1>(dims[i]);
-    }
-}
-
 class HalideFullSolver{
 public:
     // Inputs
@@ -55,16 +47,20 @@ public:
 #endif
     Param<double> step_size;
     Param<bool> phase_only;
+    Param<double> tolerance;
 
     
 
-    Func v_res, model, sol, next_sol, antenna_1, antenna_2, solution_index;
+    Func v_res, model, next_sol, antenna_1, antenna_2, solution_index;
     Var x, y, i, j, v, si, a, pol, c, cb, d;
 
+    PadreOptions options;
     int schedule;
+    int vec;
+    int chunk;
     bool gpu;
 
-    HalideFullSolver() :
+    HalideFullSolver(PadreOptions options) :
         ant(type_of<int32_t>(), 3, "ant"), // <3>[n_cb][n_vis][2] uint32_t
         solution_map(type_of<int32_t>(), 3, "solution_map"), // <3>[n_cb][dir][n_vis] uint32_t
         v_res_(type_of<float>(), 5, "v_res_"), // <5>[n_cb][n_vis], Complex 2x2 Float (+3)
@@ -88,10 +84,12 @@ public:
 #endif
         step_size("step_size"),
         phase_only("phase_only"),
+        tolerance("tolerance"),
         
-        v_res("v_res"), model("model"), sol("sol"), next_sol("next_sol"),
+        v_res("v_res"), model("model"), next_sol("next_sol"),
         antenna_1("antenna_1"), antenna_2("antenna_2"), solution_index("solution_index"),
-        x("x"), y("y"), i("i"), j("j"), v("v"), si("si"), a("a"), pol("pol"), c("c"), cb("cb"), d("d")
+        x("x"), y("y"), i("i"), j("j"), v("v"), si("si"), a("a"), pol("pol"), c("c"), cb("cb"), d("d"),
+        options(options)
         {
 #ifdef CONCRETE_BOUNDS
             n_cb = 4;
@@ -102,13 +100,17 @@ public:
             max_n_directions = 3;
 #endif
 
-        schedule = 0;
+        schedule = options.schedule >= 0 ? options.schedule : 0;
+        vec = 8;
+        chunk = options.chunk > 0 ? options.chunk : 2048;
 
         set_bounds({{0,2}, {0, max_n_visibilities}, {0,n_cb}}, ant);
         set_bounds({{0, max_n_visibilities}, {0,max_n_directions}, {0,n_cb}}, solution_map);
 
-        set_bounds({{0, 2}, {0, 2}, {0, 2}, {0, max_n_visibilities}, {0,n_cb}}, v_res_);
-        set_bounds({{0, 2}, {0, 2}, {0, 2}, {0, max_n_visibilities}, {0,max_n_directions}, {0,n_cb}}, model_);
+        set_complex_bounds({{0, 2}, {0, 2}, {0, 2}, {0, max_n_visibilities}, {0,n_cb}}, v_res_,
+            options.split_complex, 3);
+        set_complex_bounds({{0, 2}, {0, 2}, {0, 2}, {0, max_n_visibilities}, {0,max_n_directions}, {0,n_cb}}, model_,
+            options.split_complex, 3);
         set_bounds({{0, 2}, {0, 2}, {0, n_sol}, {0, n_antennas}, {0,n_cb}}, sol_);
         set_bounds({{0, 2}, {0, 2}, {0, n_sol}, {0, n_antennas}, {0,n_cb}}, next_sol_);
 
@@ -118,7 +120,6 @@ public:
         set_bounds({{0, n_cb}}, n_vis);
         
         model(v, d, cb) = toComplexMatrix(model_, {v, d, cb});
-        sol(si, a, cb) = toComplexDiagMatrix(sol_, {si, a, cb});
         next_sol(si, a, cb) = toComplexDiagMatrix(next_sol_, {si, a, cb});
         
         antenna_1(v, cb) = unsafe_promise_clamped(cast<int>(ant(0, v, cb)), 0, n_antennas-1);
@@ -133,7 +134,7 @@ public:
         Matrix m = Matrix(in(args));
         Func v_res_out("v_res_out");
 
-        v_res_out(concat({c, i, j}, args)) = select(
+        v_res_out(concat({c, i, j}, args)) = cast<float>(select(
             c == 0 && i == 0 && j == 0, m.m00.real,
             c == 1 && i == 0 && j == 0, m.m00.imag,
             c == 0 && i == 1 && j == 0, m.m01.real,
@@ -142,7 +143,7 @@ public:
             c == 1 && i == 0 && j == 1, m.m10.imag,
             c == 0 && i == 1 && j == 1, m.m11.real,
             m.m11.imag
-        );
+        ));
         v_res_out.bound(c, 0, 2).bound(i, 0, 2).bound(j, 0, 2);
 
         return v_res_out;
@@ -166,18 +167,30 @@ public:
         return Matrix(c1, c2, c3, c4);
     }
 
-    Func out(int debug_stop, bool gpu){
-        Func result("out");
-        Func v_res_sub("v_res_sub");
-        Func denominator_inter("denominator_inter"), numerator_inter("numerator_inter");
-        Func numerator("numerator"), denominator("denominator");
-        Func ant_i("ant_i");
-        Func contribution("contribution");
-        Func cor_model_transp_1("cor_model_transp_1"), cor_model_2("cor_model_2");
+    // One iteration starting from the solutions sol_in, with dimensions [re/im][pol][si][a][cb] as sol_.
+    // The names of its Funcs end with tag, which tells several iterations in one pipeline apart.
+    Func out(int debug_stop, bool gpu, Func sol_in, std::string tag = ""){
+        Func result("out" + tag);
+        Func v_res_sub("v_res_sub" + tag);
+        Func denominator_inter("denominator_inter" + tag), numerator_inter("numerator_inter" + tag);
+        Func numerator("numerator" + tag), denominator("denominator" + tag);
+        Func ant_i("ant_i" + tag);
+        Func contribution("contribution" + tag);
+        Func cor_model_transp_1("cor_model_transp_1" + tag), cor_model_2("cor_model_2" + tag);
+
+        // Contributions are computed in ct and subtracted in ca, the terms of the solve
+        // are computed in st and summed in sa.
+        Type ct = compute_type(options.contribution);
+        Type ca = accumulate_type(options.contribution);
+        Type st = compute_type(options.solve);
+        Type sa = accumulate_type(options.solve);
+
+        Func sol("sol" + tag);
+        sol(si, a, cb) = toComplexDiagMatrix(sol_in, {si, a, cb});
 
         // First, substract all contributions from the current model
         Expr vb = clamp(v, 0, n_vis(cb)-1);
-        v_res_sub(v, cb) = v_res(vb, cb);
+        v_res_sub(v, cb) = castT(ca, v_res(vb, cb));
         if(debug_stop == 0){
             Func res = matrixToDimensions(v_res_sub, {v, cb});
             set_bounds({{0, 2}, {0, 2}, {0, 2}, {0, max_n_visibilities}, {0, n_cb}}, res.output_buffer());
@@ -186,10 +199,10 @@ public:
         RDom dir(0, max_n_directions, "dir");
         dir.where(dir < n_dir(cb));
 
-        MatrixDiag solution_1 = castT<float>(sol(solution_index(v, d, cb), antenna_1(v, cb), cb));
-        MatrixDiag solution_2 = castT<float>(sol(solution_index(v, d, cb), antenna_2(v, cb), cb));
-        contribution(v, d, cb) = solution_1 * Matrix(model(v, d, cb)) * HermTranspose(solution_2);
-        v_res_sub(v, cb) = Matrix(v_res_sub(v, cb)) - Matrix(contribution(vb, dir, cb));
+        MatrixDiag solution_1 = castT(ct, sol(solution_index(v, d, cb), antenna_1(v, cb), cb));
+        MatrixDiag solution_2 = castT(ct, sol(solution_index(v, d, cb), antenna_2(v, cb), cb));
+        contribution(v, d, cb) = solution_1 * Matrix(castT(ct, model(v, d, cb))) * HermTranspose(solution_2);
+        v_res_sub(v, cb) = Matrix(v_res_sub(v, cb)) - Matrix(castT(ca, contribution(vb, dir, cb)));
         if(debug_stop == 1){
             Func res = matrixToDimensions(v_res_sub, {v, cb});
             set_bounds({{0, 2}, {0, 2}, {0, 2}, {0, max_n_visibilities}, {0, n_cb}}, res.output_buffer());
@@ -198,19 +211,23 @@ public:
 
         ///////////////////////////////////////////
         // Add this direction back before solving
-        Func vis_in_add("vis_in_add");
-        vis_in_add(v, d, cb) = Matrix(v_res_sub(v, cb)) + Matrix(contribution(v, d, cb));
+        Func vis_in_add("vis_in_add" + tag);
+        vis_in_add(v, d, cb) = Matrix(v_res_sub(v, cb)) + Matrix(castT(ca, contribution(v, d, cb)));
 
-        cor_model_transp_1(v, d, cb) = solution_2 * HermTranspose(Matrix(model(v, d, cb)));
-        cor_model_2(v, d, cb) = solution_1 * Matrix(model(v, d, cb));
+        MatrixDiag solve_1 = castT(st, sol(solution_index(v, d, cb), antenna_1(v, cb), cb));
+        MatrixDiag solve_2 = castT(st, sol(solution_index(v, d, cb), antenna_2(v, cb), cb));
+        Matrix model_s = castT(st, model(v, d, cb));
+        cor_model_transp_1(v, d, cb) = solve_2 * HermTranspose(model_s);
+        cor_model_2(v, d, cb) = solve_1 * model_s;
 
         ////////////////////////////////
         // Inter
-        numerator_inter(a, v, d, cb) = {undef<float>(), undef<float>(), undef<float>(), undef<float>()};
-        numerator_inter(0, v, d, cb) = Diagonal(Matrix(vis_in_add(v,d,cb)) * Matrix(cor_model_transp_1(v,d,cb)));
-        numerator_inter(1, v, d, cb) = Diagonal(HermTranspose(Matrix(vis_in_add(v,d,cb))) * Matrix(cor_model_2(v,d,cb)));
+        Matrix vis = castT(st, vis_in_add(v,d,cb));
+        numerator_inter(a, v, d, cb) = {undef(st), undef(st), undef(st), undef(st)};
+        numerator_inter(0, v, d, cb) = Diagonal(vis * Matrix(cor_model_transp_1(v,d,cb)));
+        numerator_inter(1, v, d, cb) = Diagonal(HermTranspose(vis) * Matrix(cor_model_2(v,d,cb)));
 
-        denominator_inter(a, i, v, d, cb) = undef<float>();
+        denominator_inter(a, i, v, d, cb) = undef(st);
         denominator_inter(0, 0, v, d, cb) = Matrix(cor_model_transp_1(v,d,cb)).m00.norm() + Matrix(cor_model_transp_1(v,d,cb)).m10.norm();
         denominator_inter(0, 1, v, d, cb) = Matrix(cor_model_transp_1(v,d,cb)).m01.norm() + Matrix(cor_model_transp_1(v,d,cb)).m11.norm();
         denominator_inter(1, 0, v, d, cb) = Matrix(cor_model_2(v,d,cb)).m00.norm() + Matrix(cor_model_2(v,d,cb)).m10.norm();
@@ -222,10 +239,13 @@ public:
         rv2.where(rv2.y < n_vis(cb));
         // Expr rel_si = unsafe_promise_clamped(solution_index(rv2.y, d, cb) - n_sol0_direction(d, cb), 0, max_n_direction_solutions-1);
         Expr rel_si = clamp(solution_index(rv2.y, d, cb) - n_sol0_direction(d, cb), 0, max_n_direction_solutions-1);
-        numerator(si,a,d,cb) = MatrixDiag({0.0f, 0.0f, 0.0f, 0.0f});
-        numerator(rel_si, ant_i(rv2.x, rv2.y, cb), d, cb) += numerator_inter(rv2.x, rv2.y, d, cb);
-        denominator(i,si,a,d,cb) = 0.0f;
-        denominator(i,rel_si, ant_i(rv2.x, rv2.y, cb), d, cb) += denominator_inter(rv2.x, i, rv2.y, d, cb);
+        Expr zero = cast(sa, 0.0f);
+        Expr r_a = ant_i(rv2.x, rv2.y, cb);
+        numerator(si,a,d,cb) = MatrixDiag({zero, zero, zero, zero});
+        numerator(rel_si, r_a, d, cb) = MatrixDiag(numerator(rel_si, r_a, d, cb))
+            + MatrixDiag(castT(sa, numerator_inter(rv2.x, rv2.y, d, cb)));
+        denominator(i,si,a,d,cb) = zero;
+        denominator(i,rel_si, r_a, d, cb) += cast(sa, denominator_inter(rv2.x, i, rv2.y, d, cb));
 
         ///////////////////
 
@@ -234,7 +254,7 @@ public:
         
         RDom si_r(0, max_n_direction_solutions, "si_r");
         si_r.where(si_r < n_sol_direction(d, cb));
-        Func next_solutions_complex0("next_solutions_complex0");
+        Func next_solutions_complex0("next_solutions_complex0" + tag);
         next_solutions_complex0(pol,si,d,a,cb) = {undef<double>(), undef<double>()};
         next_solutions_complex0(pol,si_r,d,a,cb) = tuple_select(
             denominator(pol,si_r,a,d,cb) == 0.0f, cnan,
@@ -246,20 +266,20 @@ public:
         RVar d_r = d_r2.y;
         RVar si_r2 = d_r2.x;
         d_r2.where( d_r < n_dir(cb) && si_r2 < n_sol_direction(d_r, cb));
-        Func next_solutions_complex1("next_solutions_complex1");
+        Func next_solutions_complex1("next_solutions_complex1" + tag);
         // Expr si_total = unsafe_promise_clamped(n_sol0_direction(d_r, cb) + si_r2, 0, n_sol-1);
         Expr si_total = clamp(n_sol0_direction(d_r, cb) + si_r2, 0, n_sol-1);
         next_solutions_complex1(pol,si,a,cb) = {undef<double>(), undef<double>()};
         next_solutions_complex1(pol,si_total,a,cb) = next_solutions_complex0(pol,si_r2,d_r,a,cb);
 
-        Func next_solutions("next_solutions");
+        Func next_solutions("next_solutions" + tag);
 
         // Step
         Expr pi = Expr(M_PI);
-        Func distance0("distance0");
-        Func distance1("distance1");
-        Func next_solutions_step("next_solutions_step");
-        Complex sol_c = Complex(sol_(0, i, si, a, cb), sol_(1, i, si, a, cb));
+        Func distance0("distance0" + tag);
+        Func distance1("distance1" + tag);
+        Func next_solutions_step("next_solutions_step" + tag);
+        Complex sol_c = Complex(sol_in(0, i, si, a, cb), sol_in(1, i, si, a, cb));
         Expr phase_from = arg(sol_c);
         distance0(i, si, a, cb) = phase_from - arg(next_solutions_complex1(i, si, a, cb));
         distance1(i, si, a, cb) = select(distance0(i, si, a, cb) > pi, distance0(i, si, a, cb) - 2*pi, distance0(i, si, a, cb) + 2*pi);
@@ -274,7 +294,6 @@ public:
             {Complex(next_solutions_step(i, si, a, cb)).real, 
              Complex(next_solutions_step(i, si, a, cb)).imag});
         next_solutions.bound(c,0,2).bound(i, 0, 2).bound(a, 0, n_antennas).bound(si, 0, n_sol).bound(cb, 0, n_cb);
-        set_bounds({{0, 2}, {0, 2}, {0, n_sol}, {0, n_antennas}, {0, n_cb}}, next_solutions.output_buffer());
 
         if(gpu){
             Var block("block"), thread("thread"), fuse("fuse");
@@ -364,6 +383,50 @@ public:
                 .update()
                 .reorder(dir, v, cb)
                 ;
+        } else if(schedule == 2){
+            // Stream over blocks of chunk visibilities. For a block the contributions of all
+            // directions and the residual are computed once, and then added to the numerators
+            // and denominators of all directions, so every block is read once per iteration.
+            next_solutions.compute_root()
+                .unroll(i)
+                .unroll(c)
+                .specialize(phase_only)
+                .parallel(cb)
+                ;
+
+            next_solutions_complex1.compute_root()
+                .update()
+                .reorder(pol, si_r2, a, d_r)
+                .unroll(pol)
+                .parallel(cb)
+                ;
+            next_solutions_complex0.compute_at(next_solutions_complex1, d_r)
+                .update()
+                .reorder(pol, si_r, d, a)
+                .unroll(pol);
+                ;
+
+            RVar r_out("r_out"), r_in("r_in");
+            denominator.compute_at(next_solutions_complex1, cb)
+                .update()
+                .split(rv2.y, r_out, r_in, chunk, TailStrategy::GuardWithIf)
+                .reorder(i, rv2.x, r_in, d, r_out)
+                .unroll(i)
+                .unroll(rv2.x)
+                ;
+            numerator.compute_at(next_solutions_complex1, cb)
+                .update()
+                .split(rv2.y, r_out, r_in, chunk, TailStrategy::GuardWithIf)
+                .reorder(rv2.x, r_in, d, r_out)
+                .unroll(rv2.x)
+                .compute_with(denominator.update(), r_in);
+                ;
+
+            contribution.compute_at(denominator, r_out);
+            v_res_sub.compute_at(denominator, r_out)
+                .update()
+                .reorder(dir, v, cb)
+                ;
         } else {
             Var fuse("fuse"), a_out("a_out"), a_in("a_in");
             next_solutions.compute_root()
@@ -403,7 +466,7 @@ public:
                 ;
 
             Var par("par");
-            Func denom_inter("denom_inter");
+            Func denom_inter("denom_inter" + tag);
             denom_inter = denominator.update().rfactor(r_out, par);
             denom_inter.compute_at(next_solutions_complex1, d_r)
                 .parallel(par)
@@ -421,7 +484,7 @@ public:
                 .split(rv2.y, r_out, r_in, max_n_visibilities/8, TailStrategy::GuardWithIf)
                 ;
 
-            Func num_inter("denom_inter");
+            Func num_inter("denom_inter" + tag);
             num_inter = numerator.update().rfactor(r_out, par);
             num_inter.compute_at(next_solutions_complex1, d_r)
                 .parallel(par)
@@ -443,11 +506,57 @@ public:
                 .parallel(v_out)
                 .reorder(dir, v_in, v_out, cb)
                 ;
+            if(options.static_library){
+                Var v_vec("v_vec");
+                v_res_sub.vectorize(v, vec, TailStrategy::GuardWithIf)
+                    .update()
+                    .split(v_in, v_in, v_vec, vec, TailStrategy::GuardWithIf)
+                    .vectorize(v_vec)
+                    ;
+            }
         }
 
         return next_solutions;
     }
 
+    // options.iterations iterations in one pipeline, so the visibilities and the model stay
+    // resident and the caller only gets the solutions after the last one. After each iteration
+    // a channel block whose solutions changed at most tolerance, relative to their largest
+    // absolute value, is converged and keeps its solutions for the remaining iterations.
+    Func iterate(){
+        Func solutions = sol_;
+        Func converged("converged");
+        converged(cb) = cast<bool>(false);
+        for(int k = 0; k < options.iterations; k++){
+            std::string tag = "_" + std::to_string(k);
+            Func step = out(-1, false, solutions, tag);
+
+            RDom r(0, 2, 0, 2, 0, n_sol, 0, n_antennas, "r" + tag);
+            Expr from = solutions(r.x, r.y, r.z, r.w, cb);
+            Func change("change" + tag), magnitude("magnitude" + tag);
+            change(cb) = maximum(abs(step(r.x, r.y, r.z, r.w, cb) - from));
+            magnitude(cb) = maximum(abs(from));
+
+            Func next("solutions" + tag), next_converged("converged" + tag);
+            next(c, i, si, a, cb) = select(converged(cb), solutions(c, i, si, a, cb), step(c, i, si, a, cb));
+            next_converged(cb) = converged(cb) || change(cb) <= tolerance * magnitude(cb);
+
+            next.bound(c, 0, 2).bound(i, 0, 2).bound(si, 0, n_sol).bound(a, 0, n_antennas).bound(cb, 0, n_cb);
+            next.compute_root()
+                .unroll(c)
+                .unroll(i)
+                .parallel(cb)
+                ;
+            next_converged.compute_root();
+            change.compute_at(next_converged, cb);
+            magnitude.compute_at(next_converged, cb);
+
+            solutions = next;
+            converged = next_converged;
+        }
+        return solutions;
+    }
+
     void compile(bool non_unique){
         try{
 #ifdef CONCRETE_BOUNDS
@@ -465,6 +574,9 @@ public:
               n_cb, n_sol, n_antennas, max_n_visibilities, max_n_direction_solutions, max_n_directions,
               step_size, phase_only};
 #endif
+            if(options.iterations > 1){
+                args.push_back(tolerance);
+            }
             Target target = get_target_from_environment();
             target.set_features({Target::NoAsserts, Target::NoBoundsQuery});
             #ifndef HAVE_HALIVER
@@ -472,13 +584,15 @@ public:
             target.set_features({Target::CUDA, Target::CLDoubles});
             #endif
             // Func debug_vres_in("debug_vres_in");
-            // debug_vres_in = out(0, false);
+            // debug_vres_in = out(0, false, sol_);
             // Func debug_substract_all("debug_substract_all");
-            // debug_substract_all = out(1, false);
+            // debug_substract_all = out(1, false, sol_);
             Func result("out"), result_gpu("out_gpu");
-            result = out(-1, false);
+            result = options.iterations > 1 ? iterate() : out(-1, false, sol_);
+            set_bounds({{0, 2}, {0, 2}, {0, n_sol}, {0, n_antennas}, {0, n_cb}}, result.output_buffer());
 #ifndef HAVE_HALIVER
-            result_gpu = out(-1, true);
+            result_gpu = out(-1, true, sol_);
+            set_bounds({{0, 2}, {0, 2}, {0, n_sol}, {0, n_antennas}, {0, n_cb}}, result_gpu.output_buffer());
 #endif
 
 #ifdef HAVE_HALIVER
@@ -495,7 +609,14 @@ public:
             std::string cb = "";
 #endif
             std::string NU = non_unique ? "_non_unique" : "";
-            std::string postfix = cb + NU;
+            std::string postfix = cb + options.suffix + NU;
+            if(options.static_library){
+                // Linked with the runtime of the Diagonal libraries
+                target.set_feature(Target::NoRuntime);
+                result.compile_to_static_library("PerformIterationHalide" + postfix, args,
+                    "PerformIterationHalide" + postfix, target);
+                return;
+            }
             result.compile_to_c("PerformIterationHalide"+ postfix + ".c", args, {}, 
                 "PerformIterationHalide"+postfix, target, false, !non_unique);
 #else
@@ -520,10 +641,14 @@ public:
 };
 
 int main(int argc, char **argv){
+    PadreOptions options;
+    int res = read_padre_args(argc, argv, options);
+    if(res != 0) return res;
 
-    HalideFullSolver solver;
-    solver.compile(true);
+    HalideFullSolver solver(options);
+    solver.compile(!options.static_library);
+    if(options.static_library) return 0;
 
-    HalideFullSolver solver2;
+    HalideFullSolver solver2(options);
     solver2.compile(false);
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "Halide.h"
+#include "PadreOptions.h"
+#define HAVE_HALIVER
+// #define CONCRETE_BOUNDS
+
+// Reorders the visibilities of the inputs of GenerateHalideDiagonal with a permutation
+// computed by the caller, e.g. sorted by (antenna_1, antenna_2, solution) so the lookups of
+// the solutions are sequential, and restores the original order of the residual.
+//   GatherIndices:       out(v) = in(perm(v)), for ant1, ant2 and solution_map
+//   GatherVisibilities:  out(c, i, j, v) = in(c, i, j, perm(v)), for v_res_in and model_
+//   RestoreVisibilities: out(c, i, j, v) = in(c, i, j, inv_perm(v))
+using namespace Halide;
+
+class HalideReorder{
+public:
+    // Inputs
+    ImageParam perm;
+    ImageParam inv_perm;
+    ImageParam indices;
+    ImageParam vis;
+#ifdef CONCRETE_BOUNDS
+    Expr n_vis;
+#else
+    Param<int> n_vis;
+#endif
+
+    Func permutation, inverse_permutation;
+    Var c, i, j, v;
+    std::vector<Argument> index_args, vis_args;
+
+    PadreOptions options;
+    int block;
+
+    HalideReorder(PadreOptions options) :
+        perm(type_of<int32_t>(), 1, "perm"), // <1>[n_vis] int32_t, visibility v of the output is perm(v) of the input
+        inv_perm(type_of<int32_t>(), 1, "inv_perm"), // <1>[n_vis] int32_t, inverse of perm
+        indices(type_of<int32_t>(), 1, "indices"), // <1>[n_vis] int32_t
+        vis(type_of<float>(), 4, "vis"), // <4>[n_vis], Complex 2x2 Float (+3)
+#ifndef CONCRETE_BOUNDS
+        n_vis("n_vis"),
+#endif
+        permutation("permutation"), inverse_permutation("inverse_permutation"),
+        c("c"), i("i"), j("j"), v("v"),
+        options(options){
+
+#ifdef CONCRETE_BOUNDS
+        n_vis = 230930;
+#endif
+        block = options.chunk > 0 ? options.chunk : 4096;
+
+        set_bounds({{0, n_vis}}, perm);
+        set_bounds({{0, n_vis}}, inv_perm);
+        set_bounds({{0, n_vis}}, indices);
+        set_complex_bounds({{0, 2}, {0, 2}, {0, 2}, {0, n_vis}}, vis, options.split_complex, 3);
+
+        permutation(v) = unsafe_promise_clamped(perm(v), 0, n_vis-1);
+        inverse_permutation(v) = unsafe_promise_clamped(inv_perm(v), 0, n_vis-1);
+
+#ifdef CONCRETE_BOUNDS
+        index_args = {perm, inv_perm, indices};
+        vis_args = {perm, inv_perm, vis};
+#else
+        index_args = {perm, inv_perm, indices, n_vis};
+        vis_args = {perm, inv_perm, vis, n_vis};
+#endif
+    }
+
+    Func GatherIndices(){
+        Func out("gather_indices");
+        out(v) = indices(permutation(v));
+#ifdef HAVE_HALIVER
+        out.ensures(out(v) == indices(perm(v)));
+#endif
+
+        set_bounds({{0, n_vis}}, out.output_buffer());
+        Var v_out("v_out"), v_in("v_in");
+        out.split(v, v_out, v_in, block, TailStrategy::GuardWithIf)
+            .parallel(v_out)
+            ;
+        if(options.static_library){
+            out.vectorize(v_in, 8, TailStrategy::GuardWithIf);
+        }
+        return out;
+    }
+
+    // Visibility v of the output is visibility p(v) of vis
+    Func Gather(std::string name, Func p, ImageParam p_in){
+        Func out(name);
+        out(c, i, j, v) = vis(c, i, j, p(v));
+#ifdef HAVE_HALIVER
+        out.ensures(out(c, i, j, v) == vis(c, i, j, p_in(v)));
+#endif
+
+        out.bound(c, 0, 2).bound(i, 0, 2).bound(j, 0, 2);
+        set_complex_bounds({{0, 2}, {0, 2}, {0, 2}, {0, n_vis}}, out.output_buffer(), options.split_complex, 3);
+        Var v_out("v_out"), v_in("v_in");
+        out.reorder(c, i, j, v)
+            .split(v, v_out, v_in, block, TailStrategy::GuardWithIf)
+            .parallel(v_out)
+            .unroll(c)
+            .unroll(i)
+            .unroll(j)
+            ;
+        return out;
+    }
+
+    void compile(bool non_unique){
+        try{
+            Target target = get_target_from_environment();
+            target.set_features({Target::NoAsserts, Target::NoBoundsQuery});
+
+#ifdef HAVE_HALIVER
+            // perm is a bijection on [0, n_vis): it stays in range and inv_perm undoes it
+            perm.requires((perm(_0) >= 0 && perm(_0) < n_vis));
+            inv_perm.requires((inv_perm(_0) >= 0 && inv_perm(_0) < n_vis
+                && perm(inv_perm(_0)) == _0 && inv_perm(perm(_0)) == _0));
+            Annotation bounds = context_everywhere(n_vis > 0);
+#endif
+#ifdef CONCRETE_BOUNDS
+            std::string cb = "CB";
+#else
+            std::string cb = "";
+#endif
+            std::string NU = non_unique ? "_non_unique" : "";
+            std::string postfix = cb + options.suffix + NU;
+
+            Func gather_indices = GatherIndices();
+            Func gather_vis = Gather("gather_visibilities", permutation, perm);
+            Func restore_vis = Gather("restore_visibilities", inverse_permutation, inv_perm);
+
+            if(options.static_library){
+                // Linked with the runtime of the Diagonal libraries
+                target.set_feature(Target::NoRuntime);
+                gather_indices.compile_to_static_library("GatherIndicesHalide" + postfix, index_args,
+                    "GatherIndicesHalide" + postfix, target);
+                gather_vis.compile_to_static_library("GatherVisibilitiesHalide" + postfix, vis_args,
+                    "GatherVisibilitiesHalide" + postfix, target);
+                restore_vis.compile_to_static_library("RestoreVisibilitiesHalide" + postfix, vis_args,
+                    "RestoreVisibilitiesHalide" + postfix, target);
+                return;
+            }
+#ifdef HAVE_HALIVER
+            gather_indices.compile_to_c("GatherIndicesHalide" + postfix + ".c", index_args, {bounds},
+                "GatherIndicesHalide" + postfix, target, false, !non_unique);
+            gather_vis.compile_to_c("GatherVisibilitiesHalide" + postfix + ".c", vis_args, {bounds},
+                "GatherVisibilitiesHalide" + postfix, target, false, !non_unique);
+            restore_vis.compile_to_c("RestoreVisibilitiesHalide" + postfix + ".c", vis_args, {bounds},
+                "RestoreVisibilitiesHalide" + postfix, target, false, !non_unique);
+#endif
+        } catch (Halide::Error &e){
+            std::cerr << "Halide Error: " << e.what() << std::endl;
+            __throw_exception_again;
+        }
+    }
+};
+
+int main(int argc, char **argv){
+    PadreOptions options;
+    int res = read_padre_args(argc, argv, options);
+    if(res != 0) return res;
+
+    HalideReorder reorder(options);
+    reorder.compile(false);
+    if(options.static_library) return 0;
+
+    HalideReorder reorder2(options);
+    reorder2.compile(true);
+}
@@ -1,3 +1,4 @@
+#pragma once
 #include "Halide.h"
 
 using namespace Halide;
@@ -193,6 +194,14 @@ inline Complex castC(Complex t) {
     return castT<T>(t);
 }
 
+inline Tuple castT(Type type, Tuple t) {
+    std::vector<Expr> result;
+    std::transform(t.as_vector().begin(), t.as_vector().end(), std::back_inserter(result), [&](Expr e) {
+        return cast(type, std::move(e));
+    });
+    return Tuple(result);
+}
+
 inline Expr arg(Complex t){
     return atan2(t.imag, t.real);
 }
@@ -0,0 +1,176 @@
+#pragma once
+#include "Halide.h"
+#include <stdio.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Precision of a stage of the solver
+enum class Precision {
+    // Compute and accumulate in float
+    Float,
+    // Compute and accumulate in double
+    Double,
+    // Compute in float, accumulate in double
+    Mixed
+};
+
+inline Halide::Type compute_type(Precision p){
+    return p == Precision::Double ? Halide::Float(64) : Halide::Float(32);
+}
+
+inline Halide::Type accumulate_type(Precision p){
+    return p == Precision::Float ? Halide::Float(32) : Halide::Float(64);
+}
+
+// Options of the padre generators, read from the command line. E.g.
+//   ./GenerateHalideDiagonal suffix SC layout split schedule 3
+//   ./GenerateHalideFull suffix Mixed precision solve=mixed
+struct PadreOptions {
+    // Added to the names of the generated files and functions
+    std::string suffix = "";
+    // Store complex buffers with the real and imaginary parts in separate planes,
+    // the visibility dimension innermost, instead of interleaved [re, im] pairs.
+    bool split_complex = false;
+    // Schedule to use, -1 keeps the default of the generator
+    int schedule = -1;
+    // Number of visibilities per block in the blocked schedules, -1 keeps the default of the generator
+    int chunk = -1;
+    // Number of partial sums that schedule 2 of GenerateHalideDiagonal computes in parallel
+    // with rfactor before adding them up. 0 keeps the default of the generator.
+    int parts = 0;
+    // Emit static libraries instead of C code for verification. Only these
+    // use vectorize, which the HaliVer back end does not support.
+    bool static_library = false;
+    // Precision of subtracting the contributions of the directions from the visibilities
+    Precision contribution = Precision::Float;
+    // Precision of the numerator and denominator sums over the visibilities.
+    // The solutions themselves and the step are always in double.
+    Precision solve = Precision::Float;
+    // Number of iterations done by one call of PerformIterationHalide. With more than one,
+    // a channel block stops changing once its solutions converged within `tolerance`.
+    int iterations = 1;
+};
+
+inline int read_precision(std::string value, PadreOptions &options){
+    size_t eq = value.find('=');
+    std::string stage = value.substr(0, eq);
+    std::string type = eq == std::string::npos ? "" : value.substr(eq + 1);
+    Precision p;
+    if(type == "float"){
+        p = Precision::Float;
+    } else if(type == "double"){
+        p = Precision::Double;
+    } else if(type == "mixed"){
+        p = Precision::Mixed;
+    } else {
+        printf("Invallid precision %s\n", value.c_str());
+        return 1;
+    }
+
+    if(stage == "contribution" || stage == "all"){
+        options.contribution = p;
+    }
+    if(stage == "solve" || stage == "all"){
+        options.solve = p;
+    }
+    if(stage != "contribution" && stage != "solve" && stage != "all"){
+        printf("Invallid precision stage %s\n", stage.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+inline int read_padre_args(int argc, char **argv, PadreOptions &options){
+    std::string suffix_s = "suffix";
+    std::string layout_s = "layout";
+    std::string schedule_s = "schedule";
+    std::string chunk_s = "chunk";
+    std::string parts_s = "parts";
+    std::string static_s = "static";
+    std::string precision_s = "precision";
+    std::string iterations_s = "iterations";
+
+    for(int i = 1; i < argc; i++){
+        bool has_value = i + 1 < argc;
+        if(suffix_s.compare(argv[i]) == 0 && has_value){
+            options.suffix = argv[++i];
+        } else if(layout_s.compare(argv[i]) == 0 && has_value){
+            std::string layout = argv[++i];
+            if(layout == "split"){
+                options.split_complex = true;
+            } else if(layout == "interleaved"){
+                options.split_complex = false;
+            } else {
+                printf("Invallid layout %s\n", layout.c_str());
+                return 1;
+            }
+        } else if(schedule_s.compare(argv[i]) == 0 && has_value){
+            options.schedule = std::stoi(argv[++i]);
+        } else if(chunk_s.compare(argv[i]) == 0 && has_value){
+            options.chunk = std::stoi(argv[++i]);
+        } else if(parts_s.compare(argv[i]) == 0 && has_value){
+            options.parts = std::stoi(argv[++i]);
+        } else if(static_s.compare(argv[i]) == 0){
+            options.static_library = true;
+        } else if(precision_s.compare(argv[i]) == 0 && has_value){
+            if(read_precision(argv[++i], options) != 0) return 1;
+        } else if(iterations_s.compare(argv[i]) == 0 && has_value){
+            options.iterations = std::stoi(argv[++i]);
+            if(options.iterations < 1){
+                printf("Invallid iterations %d\n", options.iterations);
+                return 1;
+            }
+        } else {
+            printf("Invallid argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Sets dense bounds and strides on p, where order lists the dimensions from the
+// innermost (stride 1) to the outermost in memory.
+inline void set_bounds(std::vector<std::tuple<Halide::Expr, Halide::Expr>> dims, Halide::OutputImageParam p,
+    std::vector<int> order){
+    Halide::Expr stride = 1;
+    for(size_t i = 0; i < order.size(); i++){
+        int d = order[i];
+        p.dim(d).set_bounds(std::get<0>(dims[d]), std::get<1>(dims[d]));
+        p.dim(d).set_stride(stride);
+        stride *= std::get<1>(dims[d]);
+    }
+}
+
+// Sets dense bounds and strides on p, dimension 0 innermost
+inline void set_bounds(std::vector<std::tuple<Halide::Expr, Halide::Expr>> dims, Halide::OutputImageParam p){
+    std::vector<int> order;
+    for(size_t d = 0; d < dims.size(); d++){
+        order.push_back(d);
+    }
+    set_bounds(dims, p, order);
+}
+
+// Bounds for a buffer of complex numbers with the real/imaginary part in dimension 0,
+// and the visibilities in dimension vis_dim. With split_complex the visibilities are
+// innermost and dimension 0 is outermost of the matrix dimensions before it, so each
+// matrix entry is a contiguous plane of real or imaginary values per visibility.
+inline void set_complex_bounds(std::vector<std::tuple<Halide::Expr, Halide::Expr>> dims, Halide::OutputImageParam p,
+    bool split_complex, int vis_dim){
+    std::vector<int> order;
+    if(split_complex){
+        order.push_back(vis_dim);
+        for(int d = 1; d < vis_dim; d++){
+            order.push_back(d);
+        }
+        order.push_back(0);
+    } else {
+        for(int d = 0; d <= vis_dim; d++){
+            order.push_back(d);
+        }
+    }
+    for(int d = vis_dim + 1; d < (int)dims.size(); d++){
+        order.push_back(d);
+    }
+    set_bounds(dims, p, order);
+}
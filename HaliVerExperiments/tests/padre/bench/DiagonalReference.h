@@ -0,0 +1,156 @@
+#pragma once
+// Plain C++ version of the pipelines of GenerateHalideDiagonal (the diagonal solver of
+// DP3's DDECal) in std::complex<double>, as baseline for the Halide pipelines. When
+// compiled with OpenMP the loops over the visibilities and antennas run in parallel.
+#include "PadreData.h"
+
+// Diagonal of a 2x2 complex matrix, one solution of an antenna
+typedef std::array<cd, 2> Diag;
+
+struct DiagonalReference {
+    int solution_index0, n_dir_sol, n_vis, n_solutions, n_antennas;
+    std::vector<int> ant1, ant2, solution_map;
+    std::vector<Jones> v_res_in, model;
+    // [a * n_solutions + si]
+    std::vector<Diag> sol;
+
+    // Copies the inputs of the Halide pipelines
+    DiagonalReference(const DiagonalInputs &in)
+        : solution_index0(in.solution_index0), n_dir_sol(in.n_dir_sol), n_vis(in.n_vis),
+          n_solutions(in.n_solutions), n_antennas(in.n_antennas),
+          ant1(n_vis), ant2(n_vis), solution_map(n_vis), v_res_in(n_vis), model(n_vis),
+          sol(n_solutions * n_antennas) {
+        for(int v = 0; v < n_vis; v++){
+            ant1[v] = in.ant1(v);
+            ant2[v] = in.ant2(v);
+            solution_map[v] = in.solution_map(v);
+            v_res_in[v] = load_jones(in.v_res_in, v);
+            model[v] = load_jones(in.model, v);
+        }
+        for(int a = 0; a < n_antennas; a++){
+            for(int si = 0; si < n_solutions; si++){
+                sol[a * n_solutions + si] = load_diag(in.sol, si, a);
+            }
+        }
+    }
+
+    static Jones load_jones(const Buffer<float> &b, int v){
+        Jones m;
+        for(int r = 0; r < 2; r++){
+            for(int c = 0; c < 2; c++){
+                m.m[r][c] = cd(b(0, c, r, v), b(1, c, r, v));
+            }
+        }
+        return m;
+    }
+
+    static Diag load_diag(const Buffer<double> &b, int si, int a){
+        return {cd(b(0, 0, si, a), b(1, 0, si, a)), cd(b(0, 1, si, a), b(1, 1, si, a))};
+    }
+
+    const Diag &solution(int si, int a) const {
+        return sol[a * n_solutions + si];
+    }
+
+    // g1 * M * g2^H of visibility v with the current solutions
+    Jones contribution(int v) const {
+        const Diag &g1 = solution(solution_map[v], ant1[v]);
+        const Diag &g2 = solution(solution_map[v], ant2[v]);
+        Jones out;
+        for(int r = 0; r < 2; r++){
+            for(int c = 0; c < 2; c++){
+                out.m[r][c] = g1[r] * model[v].m[r][c] * std::conj(g2[c]);
+            }
+        }
+        return out;
+    }
+
+    // SubDirection: the residual without the contribution of the direction, [vis]
+    void sub_direction(std::vector<Jones> &out) const {
+        out.resize(n_vis);
+        #pragma omp parallel for
+        for(int v = 0; v < n_vis; v++){
+            Jones c = contribution(v);
+            for(int r = 0; r < 2; r++){
+                for(int col = 0; col < 2; col++){
+                    out[v].m[r][col] = v_res_in[v].m[r][col] - c.m[r][col];
+                }
+            }
+        }
+    }
+
+    // SolveDirection: new solutions of the direction, [a * n_dir_sol + si - solution_index0].
+    // Every thread sums a part of the visibilities, the parts are added up at the end.
+    void solve_direction(std::vector<Diag> &out) const {
+        int n_sums = n_dir_sol * n_antennas;
+        std::vector<Diag> numerator(n_sums, Diag{0.0, 0.0});
+        std::vector<std::array<double, 2>> denominator(n_sums, std::array<double, 2>{0.0, 0.0});
+
+        #pragma omp parallel
+        {
+            std::vector<Diag> num(n_sums, Diag{0.0, 0.0});
+            std::vector<std::array<double, 2>> den(n_sums, std::array<double, 2>{0.0, 0.0});
+
+            #pragma omp for nowait
+            for(int v = 0; v < n_vis; v++){
+                int si = solution_map[v];
+                Jones vis = v_res_in[v], c = contribution(v);
+                const Diag &s1 = solution(si, ant2[v]);
+                const Diag &s2 = solution(si, ant1[v]);
+                // cor_model_transp_1 = s1 * M^H, cor_model_2 = s2 * M
+                Jones cmt1, cm2;
+                for(int r = 0; r < 2; r++){
+                    for(int col = 0; col < 2; col++){
+                        vis.m[r][col] += c.m[r][col];
+                        cmt1.m[r][col] = s1[r] * std::conj(model[v].m[col][r]);
+                        cm2.m[r][col] = s2[r] * model[v].m[r][col];
+                    }
+                }
+
+                int k1 = ant1[v] * n_dir_sol + si - solution_index0;
+                int k2 = ant2[v] * n_dir_sol + si - solution_index0;
+                for(int p = 0; p < 2; p++){
+                    // Diagonal of vis * cor_model_transp_1 and of vis^H * cor_model_2
+                    num[k1][p] += vis.m[p][0] * cmt1.m[0][p] + vis.m[p][1] * cmt1.m[1][p];
+                    num[k2][p] += std::conj(vis.m[0][p]) * cm2.m[0][p] + std::conj(vis.m[1][p]) * cm2.m[1][p];
+                    den[k1][p] += std::norm(cmt1.m[0][p]) + std::norm(cmt1.m[1][p]);
+                    den[k2][p] += std::norm(cm2.m[0][p]) + std::norm(cm2.m[1][p]);
+                }
+            }
+
+            #pragma omp critical
+            for(int k = 0; k < n_sums; k++){
+                for(int p = 0; p < 2; p++){
+                    numerator[k][p] += num[k][p];
+                    denominator[k][p] += den[k][p];
+                }
+            }
+        }
+
+        out.resize(n_sums);
+        for(int k = 0; k < n_sums; k++){
+            for(int p = 0; p < 2; p++){
+                out[k][p] = denominator[k][p] == 0.0 ? cd(NAN, NAN) : numerator[k][p] / denominator[k][p];
+            }
+        }
+    }
+
+    // Step: moves the solutions step_size towards next, [a * n_solutions + si]. The phase
+    // distance is wrapped as in the Step of GenerateHalideDiagonal.
+    void step(const std::vector<Diag> &next, double step_size, bool phase_only, std::vector<Diag> &out) const {
+        out.resize(sol.size());
+        #pragma omp parallel for
+        for(int k = 0; k < (int) sol.size(); k++){
+            for(int p = 0; p < 2; p++){
+                if(phase_only){
+                    double phase_from = std::arg(sol[k][p]);
+                    double distance = phase_from - std::arg(next[k][p]);
+                    distance = distance > M_PI ? distance - 2 * M_PI : distance + 2 * M_PI;
+                    out[k][p] = std::polar(1.0, phase_from + step_size * distance);
+                } else {
+                    out[k][p] = sol[k][p] * (1.0 - step_size) + next[k][p] * step_size;
+                }
+            }
+        }
+    }
+};
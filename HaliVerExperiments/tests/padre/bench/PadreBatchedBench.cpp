@@ -0,0 +1,98 @@
+// Compares solving n_cb channel blocks with one call per block (GenerateHalideDiagonal)
+// against one batched call (GenerateHalideBatched), which is parallel over the blocks.
+//   ./PadreBatchedBench [n_cb] [n_antennas] [n_times] [n_dirs] [repetitions]
+#include "PadreData.h"
+#include <stdio.h>
+#include <string>
+
+#include "SolveDirectionHalideFloat.h"
+#include "SubDirectionHalideFloat.h"
+#include "SolveDirectionBatchedHalideFloat.h"
+#include "SubDirectionBatchedHalideFloat.h"
+
+// The inputs of the blocks stacked in an extra, outermost dimension
+struct BatchedInputs {
+    int n_cb;
+    const DiagonalInputs &first;
+    Buffer<int32_t> ant1, ant2, solution_map;
+    Buffer<float> v_res_in, model;
+    Buffer<double> sol;
+
+    BatchedInputs(const std::vector<DiagonalInputs> &blocks)
+        : n_cb(blocks.size()), first(blocks[0]),
+          ant1(first.n_vis, n_cb), ant2(first.n_vis, n_cb), solution_map(first.n_vis, n_cb),
+          v_res_in(2, 2, 2, first.n_vis, n_cb), model(2, 2, 2, first.n_vis, n_cb),
+          sol(2, 2, first.n_solutions, first.n_antennas, n_cb) {
+        for(int cb = 0; cb < n_cb; cb++){
+            ant1.sliced(1, cb).copy_from(blocks[cb].ant1);
+            ant2.sliced(1, cb).copy_from(blocks[cb].ant2);
+            solution_map.sliced(1, cb).copy_from(blocks[cb].solution_map);
+            v_res_in.sliced(4, cb).copy_from(blocks[cb].v_res_in);
+            model.sliced(4, cb).copy_from(blocks[cb].model);
+            sol.sliced(4, cb).copy_from(blocks[cb].sol);
+        }
+    }
+
+    Buffer<double> solve_output() const {
+        Buffer<double> out(2, 2, first.n_solutions, first.n_antennas, n_cb);
+        out.fill(0.0);
+        return out;
+    }
+
+    int solve(Buffer<double> &out){
+        Buffer<double> solved = out.cropped(2, first.solution_index0, first.n_dir_sol);
+        return SolveDirectionBatchedFloat(sol, solution_map, ant1, ant2, model, v_res_in,
+            first.solution_index0, first.n_dir_sol, first.n_vis, first.n_solutions, first.n_antennas, n_cb, solved);
+    }
+
+    int subtract(Buffer<float> &out){
+        return SubDirectionBatchedFloat(sol, solution_map, ant1, ant2, model, v_res_in,
+            first.solution_index0, first.n_dir_sol, first.n_vis, first.n_solutions, first.n_antennas, n_cb, out);
+    }
+};
+
+int main(int argc, char **argv){
+    int n_cb = argc > 1 ? std::stoi(argv[1]) : 8;
+    int n_antennas = argc > 2 ? std::stoi(argv[2]) : 50;
+    int n_times = argc > 3 ? std::stoi(argv[3]) : 10;
+    int n_dirs = argc > 4 ? std::stoi(argv[4]) : 3;
+    int repetitions = argc > 5 ? std::stoi(argv[5]) : 10;
+
+    std::vector<PadreData> problems;
+    std::vector<DiagonalInputs> blocks;
+    for(int cb = 0; cb < n_cb; cb++){
+        problems.push_back(PadreData(n_antennas, n_times, n_dirs, 42 + cb));
+    }
+    for(int cb = 0; cb < n_cb; cb++){
+        blocks.push_back(DiagonalInputs(problems[cb]));
+    }
+    BatchedInputs batched(blocks);
+    int n_vis = blocks[0].n_vis;
+
+    Buffer<double> solve_single = batched.solve_output(), solve_batched = batched.solve_output();
+    Buffer<float> sub_single(2, 2, 2, n_vis, n_cb), sub_batched(2, 2, 2, n_vis, n_cb);
+
+    double solve_single_ms = time_ms([&]{
+        for(int cb = 0; cb < n_cb; cb++){
+            Buffer<double> out = solve_single.sliced(4, cb);
+            blocks[cb].solve(SolveDirectionFloat, out);
+        }
+    }, repetitions);
+    double solve_batched_ms = time_ms([&]{ batched.solve(solve_batched); }, repetitions);
+
+    double sub_single_ms = time_ms([&]{
+        for(int cb = 0; cb < n_cb; cb++){
+            Buffer<float> out = sub_single.sliced(4, cb);
+            blocks[cb].subtract(SubDirectionFloat, out);
+        }
+    }, repetitions);
+    double sub_batched_ms = time_ms([&]{ batched.subtract(sub_batched); }, repetitions);
+
+    printf("%d channel blocks of %d visibilities, median of %d runs\n", n_cb, n_vis, repetitions);
+    printf("%-14s %12s %12s %12s\n", "", "per block ms", "batched ms", "rel. error");
+    printf("%-14s %12.3f %12.3f %12.3g\n", "SolveDirection", solve_single_ms, solve_batched_ms,
+        relative_error(solve_batched, solve_single));
+    printf("%-14s %12.3f %12.3f %12.3g\n", "SubDirection", sub_single_ms, sub_batched_ms,
+        relative_error(sub_batched, sub_single));
+    return 0;
+}
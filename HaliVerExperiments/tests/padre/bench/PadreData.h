@@ -0,0 +1,316 @@
+#pragma once
+#include "HalideBuffer.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using Halide::Runtime::Buffer;
+typedef std::complex<double> cd;
+
+// A 2x2 complex matrix, m[row][col]
+struct Jones {
+    cd m[2][2];
+};
+
+// Synthetic calibration problem: n_dirs directions with one solution each, all
+// baselines between n_antennas antennas over n_times time steps, one channel block.
+// The visibilities are generated from known gains, and the solver starts from a
+// perturbation of them.
+struct PadreData {
+    int n_antennas, n_times, n_dirs, n_vis;
+    std::vector<int> ant1, ant2;
+    // [dir][vis]
+    std::vector<std::vector<Jones>> model;
+    // [dir][ant][pol]
+    std::vector<std::vector<std::array<cd, 2>>> gains, start;
+    // [vis]
+    std::vector<Jones> data;
+
+    PadreData(int n_antennas, int n_times, int n_dirs, unsigned seed = 42)
+        : n_antennas(n_antennas), n_times(n_times), n_dirs(n_dirs) {
+        std::mt19937 gen(seed);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        std::uniform_real_distribution<double> phase(-M_PI, M_PI);
+
+        for(int t = 0; t < n_times; t++){
+            for(int a1 = 0; a1 < n_antennas; a1++){
+                for(int a2 = a1 + 1; a2 < n_antennas; a2++){
+                    ant1.push_back(a1);
+                    ant2.push_back(a2);
+                }
+            }
+        }
+        n_vis = ant1.size();
+
+        model.resize(n_dirs, std::vector<Jones>(n_vis));
+        gains.resize(n_dirs, std::vector<std::array<cd, 2>>(n_antennas));
+        start = gains;
+        for(int d = 0; d < n_dirs; d++){
+            for(int a = 0; a < n_antennas; a++){
+                for(int p = 0; p < 2; p++){
+                    gains[d][a][p] = std::polar(1.0 + 0.1 * normal(gen), phase(gen));
+                    start[d][a][p] = gains[d][a][p] * std::polar(1.0 + 0.05 * normal(gen), 0.1 * normal(gen));
+                }
+            }
+            for(int v = 0; v < n_vis; v++){
+                for(int r = 0; r < 2; r++){
+                    for(int c = 0; c < 2; c++){
+                        model[d][v].m[r][c] = cd(normal(gen), normal(gen)) * (r == c ? 1.0 : 0.1);
+                    }
+                }
+            }
+        }
+
+        data.resize(n_vis);
+        for(int v = 0; v < n_vis; v++){
+            for(int d = 0; d < n_dirs; d++){
+                Jones c = contribution(gains, d, v);
+                for(int r = 0; r < 2; r++){
+                    for(int col = 0; col < 2; col++){
+                        data[v].m[r][col] += c.m[r][col] + 0.01 * cd(normal(gen), normal(gen));
+                    }
+                }
+            }
+        }
+    }
+
+    // g1 * M * g2^H for direction d and visibility v
+    Jones contribution(const std::vector<std::vector<std::array<cd, 2>>> &g, int d, int v) const {
+        Jones out;
+        for(int r = 0; r < 2; r++){
+            for(int c = 0; c < 2; c++){
+                out.m[r][c] = g[d][ant1[v]][r] * model[d][v].m[r][c] * std::conj(g[d][ant2[v]][c]);
+            }
+        }
+        return out;
+    }
+};
+
+// Stores m in a buffer with dimensions [re/im][col][row][...], as read by toComplexMatrix
+template<typename... Args>
+void store_jones(Buffer<float> &b, const Jones &m, Args... rest){
+    for(int r = 0; r < 2; r++){
+        for(int c = 0; c < 2; c++){
+            b(0, c, r, rest...) = (float) m.m[r][c].real();
+            b(1, c, r, rest...) = (float) m.m[r][c].imag();
+        }
+    }
+}
+
+// Stores the diagonal g in a buffer with dimensions [re/im][pol][...]
+template<typename... Args>
+void store_diag(Buffer<double> &b, const std::array<cd, 2> &g, Args... rest){
+    for(int p = 0; p < 2; p++){
+        b(0, p, rest...) = g[p].real();
+        b(1, p, rest...) = g[p].imag();
+    }
+}
+
+// Copy of b in the layout of `layout split` (see set_complex_bounds in PadreOptions.h): the
+// visibilities in dimension vis_dim innermost, then the matrix dimensions, then re/im
+template<typename T>
+Buffer<T> split_complex(const Buffer<T> &b, int vis_dim = 3){
+    std::vector<int> sizes, order;
+    for(int d = 0; d < b.dimensions(); d++){
+        sizes.push_back(b.dim(d).extent());
+    }
+    order.push_back(vis_dim);
+    for(int d = 1; d < vis_dim; d++){
+        order.push_back(d);
+    }
+    order.push_back(0);
+    for(int d = vis_dim + 1; d < b.dimensions(); d++){
+        order.push_back(d);
+    }
+    Buffer<T> out(sizes, order);
+    out.copy_from(b);
+    return out;
+}
+
+// Copy of b with dimension 0 innermost, so relative_error can compare it with a buffer
+// of the default layout
+template<typename T>
+Buffer<T> interleaved(const Buffer<T> &b){
+    std::vector<int> sizes;
+    for(int d = 0; d < b.dimensions(); d++){
+        sizes.push_back(b.dim(d).extent());
+    }
+    Buffer<T> out(sizes);
+    out.copy_from(b);
+    return out;
+}
+
+// Largest difference with the reference, relative to the largest value of the reference
+template<typename T>
+double relative_error(const Buffer<T> &result, const Buffer<T> &reference){
+    double max_diff = 0, max_ref = 0;
+    const T *r = result.data(), *ref = reference.data();
+    for(size_t k = 0; k < reference.number_of_elements(); k++){
+        if(std::isnan((double) r[k]) != std::isnan((double) ref[k])) return NAN;
+        if(std::isnan((double) ref[k])) continue;
+        max_diff = std::max(max_diff, std::abs((double) r[k] - (double) ref[k]));
+        max_ref = std::max(max_ref, std::abs((double) ref[k]));
+    }
+    return max_ref == 0 ? max_diff : max_diff / max_ref;
+}
+
+// Permutation that sorts the visibilities by (antenna 1, antenna 2, solution), for
+// GenerateHalideReorder: visibility v of the sorted order is perm(v) of the original order.
+// inv_perm is its inverse.
+void sort_visibilities(const Buffer<int32_t> &ant1, const Buffer<int32_t> &ant2, const Buffer<int32_t> &solution_map,
+    Buffer<int32_t> &perm, Buffer<int32_t> &inv_perm){
+    std::vector<int32_t> order(ant1.width());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int32_t a, int32_t b){
+        if(ant1(a) != ant1(b)) return ant1(a) < ant1(b);
+        if(ant2(a) != ant2(b)) return ant2(a) < ant2(b);
+        return solution_map(a) < solution_map(b);
+    });
+    for(int v = 0; v < (int) order.size(); v++){
+        perm(v) = order[v];
+        inv_perm(order[v]) = v;
+    }
+}
+
+// Median time of repetitions calls of f, in milliseconds, after one warm-up call
+template<typename F>
+double time_ms(F f, int repetitions){
+    f();
+    std::vector<double> times;
+    for(int r = 0; r < repetitions; r++){
+        auto t0 = std::chrono::high_resolution_clock::now();
+        f();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// Arguments of PerformIterationHalide (GenerateHalideFull) for the problem, with
+// every channel block a copy of the same data
+struct FullInputs {
+    int n_cb, n_sol, n_antennas, max_n_visibilities, max_n_direction_solutions, max_n_directions;
+    Buffer<int32_t> ant, solution_map, n_sol0_direction, n_sol_direction, n_dir, n_vis;
+    Buffer<float> v_res, model;
+    Buffer<double> sol, next_sol;
+
+    FullInputs(const PadreData &p, int n_cb = 1)
+        : n_cb(n_cb), n_sol(p.n_dirs), n_antennas(p.n_antennas), max_n_visibilities(p.n_vis),
+          max_n_direction_solutions(1), max_n_directions(p.n_dirs),
+          ant(2, p.n_vis, n_cb), solution_map(p.n_vis, p.n_dirs, n_cb),
+          n_sol0_direction(p.n_dirs, n_cb), n_sol_direction(p.n_dirs, n_cb), n_dir(n_cb), n_vis(n_cb),
+          v_res(2, 2, 2, p.n_vis, n_cb), model(2, 2, 2, p.n_vis, p.n_dirs, n_cb),
+          sol(2, 2, p.n_dirs, p.n_antennas, n_cb), next_sol(2, 2, p.n_dirs, p.n_antennas, n_cb) {
+        for(int cb = 0; cb < n_cb; cb++){
+            n_dir(cb) = p.n_dirs;
+            n_vis(cb) = p.n_vis;
+            for(int d = 0; d < p.n_dirs; d++){
+                n_sol0_direction(d, cb) = d;
+                n_sol_direction(d, cb) = 1;
+                for(int a = 0; a < p.n_antennas; a++){
+                    store_diag(sol, p.start[d][a], d, a, cb);
+                    store_diag(next_sol, p.start[d][a], d, a, cb);
+                }
+            }
+            for(int v = 0; v < p.n_vis; v++){
+                ant(0, v, cb) = p.ant1[v];
+                ant(1, v, cb) = p.ant2[v];
+                store_jones(v_res, p.data[v], v, cb);
+                for(int d = 0; d < p.n_dirs; d++){
+                    solution_map(v, d, cb) = d;
+                    store_jones(model, p.model[d][v], v, d, cb);
+                }
+            }
+        }
+    }
+
+    // Stores the visibilities and the model as the pipelines built with `layout split` expect
+    void use_split_layout(){
+        v_res = split_complex(v_res);
+        model = split_complex(model);
+    }
+
+    // Output buffer for the next solutions
+    Buffer<double> output() const {
+        return Buffer<double>(2, 2, n_sol, n_antennas, n_cb);
+    }
+
+    template<typename F>
+    int run(F f, Buffer<double> &out, double step_size = 0.2, bool phase_only = false){
+        return f(ant, solution_map, v_res, model, sol, next_sol,
+            n_sol0_direction, n_sol_direction, n_dir, n_vis,
+            n_cb, n_sol, n_antennas, max_n_visibilities, max_n_direction_solutions, max_n_directions,
+            step_size, phase_only, out);
+    }
+};
+
+// Arguments of SolveDirectionHalide (GenerateHalideDiagonal) solving direction `dir` of
+// the problem. The residual has all directions subtracted with the starting solutions.
+struct DiagonalInputs {
+    int solution_index0, n_dir_sol, n_vis, n_solutions, n_antennas;
+    Buffer<int32_t> ant1, ant2, solution_map;
+    Buffer<float> v_res_in, model;
+    Buffer<double> sol;
+
+    DiagonalInputs(const PadreData &p, int dir = 0)
+        : solution_index0(dir), n_dir_sol(1), n_vis(p.n_vis), n_solutions(p.n_dirs + 1),
+          n_antennas(p.n_antennas), ant1(p.n_vis), ant2(p.n_vis), solution_map(p.n_vis),
+          v_res_in(2, 2, 2, p.n_vis), model(2, 2, 2, p.n_vis), sol(2, 2, p.n_dirs + 1, p.n_antennas) {
+        sol.fill(0.0);
+        for(int d = 0; d < p.n_dirs; d++){
+            for(int a = 0; a < p.n_antennas; a++){
+                store_diag(sol, p.start[d][a], d, a);
+            }
+        }
+        for(int v = 0; v < p.n_vis; v++){
+            ant1(v) = p.ant1[v];
+            ant2(v) = p.ant2[v];
+            solution_map(v) = dir;
+            Jones res = p.data[v];
+            for(int d = 0; d < p.n_dirs; d++){
+                Jones c = p.contribution(p.start, d, v);
+                for(int r = 0; r < 2; r++){
+                    for(int col = 0; col < 2; col++){
+                        res.m[r][col] -= c.m[r][col];
+                    }
+                }
+            }
+            store_jones(v_res_in, res, v);
+            store_jones(model, p.model[dir][v], v);
+        }
+    }
+
+    // Stores the visibilities and the model as the pipelines built with `layout split` expect
+    void use_split_layout(){
+        v_res_in = split_complex(v_res_in);
+        model = split_complex(model);
+    }
+
+    // Output buffer for all solutions, of which the solved direction is written
+    Buffer<double> output() const {
+        Buffer<double> out(2, 2, n_solutions, n_antennas);
+        out.fill(0.0);
+        return out;
+    }
+
+    // Runs SolveDirectionHalide
+    template<typename F>
+    int solve(F f, Buffer<double> &out){
+        Buffer<double> solved = out.cropped(2, solution_index0, n_dir_sol);
+        return f(sol, solution_map, ant1, ant2, model, v_res_in,
+            solution_index0, n_dir_sol, n_vis, n_solutions, n_antennas, solved);
+    }
+
+    // Runs SubDirectionHalide, out has the dimensions of v_res_in
+    template<typename F>
+    int subtract(F f, Buffer<float> &out){
+        return f(sol, solution_map, ant1, ant2, model, v_res_in,
+            solution_index0, n_dir_sol, n_vis, n_solutions, n_antennas, out);
+    }
+};
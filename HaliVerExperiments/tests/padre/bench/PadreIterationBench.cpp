@@ -0,0 +1,58 @@
+// Compares four calls of PerformIterationHalide, one iteration each, against one call of
+// the variant that does the four iterations in one pipeline (GenerateHalideFull iterations 4).
+// With tolerance 0 no channel block converges early and both give the same solutions.
+//   ./PadreIterationBench [n_antennas] [n_times] [n_dirs] [n_cb] [repetitions] [tolerance]
+#include "PadreData.h"
+#include <stdio.h>
+#include <string>
+#include <utility>
+
+#include "PerformIterationHalideFloat.h"
+#include "PerformIterationHalideIter4.h"
+
+const int iterations = 4;
+
+int main(int argc, char **argv){
+    int n_antennas = argc > 1 ? std::stoi(argv[1]) : 50;
+    int n_times = argc > 2 ? std::stoi(argv[2]) : 100;
+    int n_dirs = argc > 3 ? std::stoi(argv[3]) : 3;
+    int n_cb = argc > 4 ? std::stoi(argv[4]) : 1;
+    int repetitions = argc > 5 ? std::stoi(argv[5]) : 10;
+    double tolerance = argc > 6 ? std::stod(argv[6]) : 1e-6;
+    double step_size = 0.2;
+    bool phase_only = false;
+
+    PadreData problem(n_antennas, n_times, n_dirs);
+    FullInputs full(problem, n_cb);
+    printf("%d antennas, %d visibilities, %d directions, %d channel blocks, %d iterations, median of %d runs\n",
+        n_antennas, problem.n_vis, n_dirs, n_cb, iterations, repetitions);
+    printf("%-22s %12s %12s\n", "", "ms", "rel. error");
+
+    // The solutions of each call are the input of the next one
+    Buffer<double> from = full.output(), to = full.output();
+    double calls_ms = time_ms([&]{
+        from.copy_from(full.sol);
+        for(int k = 0; k < iterations; k++){
+            PerformIterationHalideFloat(full.ant, full.solution_map, full.v_res, full.model, from, full.next_sol,
+                full.n_sol0_direction, full.n_sol_direction, full.n_dir, full.n_vis,
+                full.n_cb, full.n_sol, full.n_antennas, full.max_n_visibilities,
+                full.max_n_direction_solutions, full.max_n_directions, step_size, phase_only, to);
+            std::swap(from, to);
+        }
+    }, repetitions);
+    printf("%-22s %12.3f %12s\n", "one call per iteration", calls_ms, "");
+
+    double tolerances[] = {0.0, tolerance};
+    for(double tol : tolerances){
+        Buffer<double> out = full.output();
+        double ms = time_ms([&]{
+            PerformIterationHalideIter4(full.ant, full.solution_map, full.v_res, full.model, full.sol, full.next_sol,
+                full.n_sol0_direction, full.n_sol_direction, full.n_dir, full.n_vis,
+                full.n_cb, full.n_sol, full.n_antennas, full.max_n_visibilities,
+                full.max_n_direction_solutions, full.max_n_directions, step_size, phase_only, tol, out);
+        }, repetitions);
+        std::string name = "one call, tol " + std::to_string(tol);
+        printf("%-22s %12.3f %12.3g\n", name.c_str(), ms, relative_error(out, from));
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+// Compares the complex layouts of the visibilities and the model (`layout split` of
+// PadreOptions.h), see build_padre_library in CMakeLists.txt for the variants:
+//   Float   interleaved, default schedules
+//   Vector  interleaved, schedule 3 of the Diagonal pipelines and schedule 1 of PerformIterationHalide
+//   Split   as Vector, with the real and imaginary parts in planes per visibility
+// Reports the time of each variant and its difference with Float.
+//   ./PadreLayoutBench [n_antennas] [n_times] [n_dirs] [n_cb] [repetitions]
+#include "PadreData.h"
+#include <stdio.h>
+#include <string>
+
+#include "PerformIterationHalideFloat.h"
+#include "PerformIterationHalideVector.h"
+#include "PerformIterationHalideSplit.h"
+#include "SolveDirectionHalideFloat.h"
+#include "SolveDirectionHalideVector.h"
+#include "SolveDirectionHalideSplit.h"
+#include "SubDirectionHalideFloat.h"
+#include "SubDirectionHalideVector.h"
+#include "SubDirectionHalideSplit.h"
+
+struct Layout {
+    std::string name;
+    bool split;
+    decltype(&PerformIterationHalideFloat) perform_iteration;
+    decltype(&SolveDirectionFloat) solve_direction;
+    decltype(&SubDirectionFloat) sub_direction;
+};
+
+int main(int argc, char **argv){
+    int n_antennas = argc > 1 ? std::stoi(argv[1]) : 50;
+    int n_times = argc > 2 ? std::stoi(argv[2]) : 100;
+    int n_dirs = argc > 3 ? std::stoi(argv[3]) : 3;
+    int n_cb = argc > 4 ? std::stoi(argv[4]) : 1;
+    int repetitions = argc > 5 ? std::stoi(argv[5]) : 10;
+
+    std::vector<Layout> layouts = {
+        {"Float", false, PerformIterationHalideFloat, SolveDirectionFloat, SubDirectionFloat},
+        {"Vector", false, PerformIterationHalideVector, SolveDirectionVector, SubDirectionVector},
+        {"Split", true, PerformIterationHalideSplit, SolveDirectionSplit, SubDirectionSplit},
+    };
+
+    PadreData problem(n_antennas, n_times, n_dirs);
+    printf("%d antennas, %d visibilities, %d directions, %d channel blocks, median of %d runs\n",
+        n_antennas, problem.n_vis, n_dirs, n_cb, repetitions);
+    printf("%-8s %14s %14s %14s %12s\n", "layout", "iteration ms", "solve dir ms", "sub dir ms", "rel. error");
+
+    Buffer<double> iteration_ref, solve_ref;
+    Buffer<float> sub_ref;
+    for(size_t k = 0; k < layouts.size(); k++){
+        Layout &l = layouts[k];
+        FullInputs full(problem, n_cb);
+        DiagonalInputs diagonal(problem);
+        Buffer<float> sub(2, 2, 2, problem.n_vis);
+        if(l.split){
+            full.use_split_layout();
+            diagonal.use_split_layout();
+            sub = split_complex(sub);
+        }
+
+        Buffer<double> iteration = full.output(), solve = diagonal.output();
+        double iteration_ms = time_ms([&]{ full.run(l.perform_iteration, iteration); }, repetitions);
+        double solve_ms = time_ms([&]{ diagonal.solve(l.solve_direction, solve); }, repetitions);
+        double sub_ms = time_ms([&]{ diagonal.subtract(l.sub_direction, sub); }, repetitions);
+
+        sub = interleaved(sub);
+        if(k == 0){
+            iteration_ref = iteration;
+            solve_ref = solve;
+            sub_ref = sub;
+        }
+        double error = std::max({relative_error(iteration, iteration_ref), relative_error(solve, solve_ref),
+            relative_error(sub, sub_ref)});
+        printf("%-8s %14.3f %14.3f %14.3f %12.3g\n", l.name.c_str(), iteration_ms, solve_ms, sub_ms, error);
+    }
+    return 0;
+}
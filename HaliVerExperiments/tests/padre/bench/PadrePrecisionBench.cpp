@@ -0,0 +1,61 @@
+// Benchmarks the precision policies of the padre pipelines, see build_padre_library
+// in CMakeLists.txt for the variants. Reports the time of each variant and its error
+// relative to the variant that computes everything in double.
+//   ./PadrePrecisionBench [n_antennas] [n_times] [n_dirs] [repetitions]
+#include "PadreData.h"
+#include <stdio.h>
+#include <string>
+
+#include "PerformIterationHalideFloat.h"
+#include "PerformIterationHalideMixed.h"
+#include "PerformIterationHalideMixedAll.h"
+#include "PerformIterationHalideDouble.h"
+#include "SolveDirectionHalideFloat.h"
+#include "SolveDirectionHalideMixed.h"
+#include "SolveDirectionHalideMixedAll.h"
+#include "SolveDirectionHalideDouble.h"
+
+struct Variant {
+    std::string name;
+    std::string policy;
+    decltype(&PerformIterationHalideDouble) perform_iteration;
+    decltype(&SolveDirectionDouble) solve_direction;
+};
+
+int main(int argc, char **argv){
+    int n_antennas = argc > 1 ? std::stoi(argv[1]) : 50;
+    int n_times = argc > 2 ? std::stoi(argv[2]) : 100;
+    int n_dirs = argc > 3 ? std::stoi(argv[3]) : 3;
+    int repetitions = argc > 4 ? std::stoi(argv[4]) : 10;
+
+    std::vector<Variant> variants = {
+        {"Double", "contribution=double solve=double", PerformIterationHalideDouble, SolveDirectionDouble},
+        {"Float", "contribution=float solve=float", PerformIterationHalideFloat, SolveDirectionFloat},
+        {"Mixed", "contribution=float solve=mixed", PerformIterationHalideMixed, SolveDirectionMixed},
+        {"MixedAll", "contribution=mixed solve=mixed", PerformIterationHalideMixedAll, SolveDirectionMixedAll},
+    };
+
+    PadreData problem(n_antennas, n_times, n_dirs);
+    FullInputs full(problem);
+    DiagonalInputs diagonal(problem);
+    printf("%d antennas, %d visibilities, %d directions, median of %d runs\n",
+        n_antennas, problem.n_vis, n_dirs, repetitions);
+    printf("%-10s %-34s %14s %12s %14s %12s\n", "variant", "policy",
+        "iteration ms", "rel. error", "solve dir ms", "rel. error");
+
+    Buffer<double> full_ref = full.output();
+    Buffer<double> diagonal_ref = diagonal.output();
+    for(size_t k = 0; k < variants.size(); k++){
+        Variant &var = variants[k];
+        Buffer<double> full_out = k == 0 ? full_ref : full.output();
+        Buffer<double> diagonal_out = k == 0 ? diagonal_ref : diagonal.output();
+
+        double full_ms = time_ms([&]{ full.run(var.perform_iteration, full_out); }, repetitions);
+        double diagonal_ms = time_ms([&]{ diagonal.solve(var.solve_direction, diagonal_out); }, repetitions);
+
+        printf("%-10s %-34s %14.3f %12.3g %14.3f %12.3g\n", var.name.c_str(), var.policy.c_str(),
+            full_ms, relative_error(full_out, full_ref),
+            diagonal_ms, relative_error(diagonal_out, diagonal_ref));
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Compares the pipelines of GenerateHalideDiagonal with the plain C++ solver of
+// DiagonalReference.h. Reports the time of both and the difference of the Halide
+// result with the reference, and fails when a relative error is above 1e-3. The reference
+// uses OpenMP when it is found by CMake.
+//   ./PadreReferenceBench [n_antennas] [n_times] [n_dirs] [repetitions] [phase_only]
+#include "DiagonalReference.h"
+#include <stdio.h>
+#include <string>
+
+#include "SolveDirectionHalideFloat.h"
+#include "SubDirectionHalideFloat.h"
+#include "StepHalideFloat.h"
+
+int main(int argc, char **argv){
+    int n_antennas = argc > 1 ? std::stoi(argv[1]) : 50;
+    int n_times = argc > 2 ? std::stoi(argv[2]) : 100;
+    int n_dirs = argc > 3 ? std::stoi(argv[3]) : 3;
+    int repetitions = argc > 4 ? std::stoi(argv[4]) : 10;
+    bool phase_only = argc > 5 ? std::stoi(argv[5]) != 0 : false;
+    double step_size = 0.2;
+
+    PadreData problem(n_antennas, n_times, n_dirs);
+    DiagonalInputs diagonal(problem);
+    DiagonalReference reference(diagonal);
+    int n_vis = problem.n_vis;
+#ifdef _OPENMP
+    std::string threads = "OpenMP";
+#else
+    std::string threads = "one thread";
+#endif
+    printf("%d antennas, %d visibilities, %d directions, reference with %s, median of %d runs\n",
+        n_antennas, n_vis, n_dirs, threads.c_str(), repetitions);
+
+    // SolveDirection
+    Buffer<double> solve_halide = diagonal.output(), solve_reference = diagonal.output();
+    std::vector<Diag> solved;
+    double solve_halide_ms = time_ms([&]{ diagonal.solve(SolveDirectionFloat, solve_halide); }, repetitions);
+    double solve_reference_ms = time_ms([&]{ reference.solve_direction(solved); }, repetitions);
+    for(int a = 0; a < n_antennas; a++){
+        for(int s = 0; s < diagonal.n_dir_sol; s++){
+            store_diag(solve_reference, solved[a * diagonal.n_dir_sol + s], diagonal.solution_index0 + s, a);
+        }
+    }
+
+    // SubDirection
+    Buffer<float> sub_halide(2, 2, 2, n_vis), sub_reference(2, 2, 2, n_vis);
+    std::vector<Jones> subtracted;
+    double sub_halide_ms = time_ms([&]{ diagonal.subtract(SubDirectionFloat, sub_halide); }, repetitions);
+    double sub_reference_ms = time_ms([&]{ reference.sub_direction(subtracted); }, repetitions);
+    for(int v = 0; v < n_vis; v++){
+        store_jones(sub_reference, subtracted[v], v);
+    }
+
+    // Step, towards the solutions of SolveDirection
+    std::vector<Diag> next(reference.sol.size()), stepped;
+    for(int a = 0; a < n_antennas; a++){
+        for(int si = 0; si < diagonal.n_solutions; si++){
+            next[a * diagonal.n_solutions + si] = DiagonalReference::load_diag(solve_reference, si, a);
+        }
+    }
+    Buffer<double> step_halide = diagonal.output(), step_reference = diagonal.output();
+    double step_halide_ms = time_ms([&]{
+        StepHalideFloat(n_vis, diagonal.n_solutions, n_antennas, phase_only, step_size,
+            diagonal.sol, solve_reference, diagonal.n_dir_sol, step_halide);
+    }, repetitions);
+    double step_reference_ms = time_ms([&]{ reference.step(next, step_size, phase_only, stepped); }, repetitions);
+    for(int a = 0; a < n_antennas; a++){
+        for(int si = 0; si < diagonal.n_solutions; si++){
+            store_diag(step_reference, stepped[a * diagonal.n_solutions + si], si, a);
+        }
+    }
+
+    double solve_error = relative_error(solve_halide, solve_reference);
+    double sub_error = relative_error(sub_halide, sub_reference);
+    double step_error = relative_error(step_halide, step_reference);
+    printf("%-14s %12s %12s %12s\n", "", "Halide ms", "C++ ms", "rel. error");
+    printf("%-14s %12.3f %12.3f %12.3g\n", "SolveDirection", solve_halide_ms, solve_reference_ms, solve_error);
+    printf("%-14s %12.3f %12.3f %12.3g\n", "SubDirection", sub_halide_ms, sub_reference_ms, sub_error);
+    printf("%-14s %12.3f %12.3f %12.3g\n", "Step", step_halide_ms, step_reference_ms, step_error);
+
+    // The Halide pipelines sum in float, the reference in double
+    const double tolerance = 1e-3;
+    if(!(solve_error <= tolerance && sub_error <= tolerance && step_error <= tolerance)){
+        printf("Relative error above %g\n", tolerance);
+        return 1;
+    }
+    return 0;
+}
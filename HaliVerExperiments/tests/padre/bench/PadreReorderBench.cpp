@@ -0,0 +1,55 @@
+// Compares SolveDirectionHalide and SubDirectionHalide (GenerateHalideDiagonal) on the
+// visibilities in time order against the visibilities sorted by antenna pair with
+// GenerateHalideReorder, which also restores the time order of the residual.
+//   ./PadreReorderBench [n_antennas] [n_times] [n_dirs] [repetitions]
+#include "PadreData.h"
+#include <stdio.h>
+#include <string>
+
+#include "SolveDirectionHalideFloat.h"
+#include "SubDirectionHalideFloat.h"
+#include "GatherIndicesHalideFloat.h"
+#include "GatherVisibilitiesHalideFloat.h"
+#include "RestoreVisibilitiesHalideFloat.h"
+
+int main(int argc, char **argv){
+    int n_antennas = argc > 1 ? std::stoi(argv[1]) : 50;
+    int n_times = argc > 2 ? std::stoi(argv[2]) : 100;
+    int n_dirs = argc > 3 ? std::stoi(argv[3]) : 3;
+    int repetitions = argc > 4 ? std::stoi(argv[4]) : 10;
+
+    PadreData problem(n_antennas, n_times, n_dirs);
+    DiagonalInputs original(problem), sorted(problem);
+    int n_vis = problem.n_vis;
+    printf("%d antennas, %d visibilities, %d directions, median of %d runs\n",
+        n_antennas, n_vis, n_dirs, repetitions);
+
+    Buffer<int32_t> perm(n_vis), inv_perm(n_vis);
+    sort_visibilities(original.ant1, original.ant2, original.solution_map, perm, inv_perm);
+    double gather_ms = time_ms([&]{
+        GatherIndicesHalideFloat(perm, inv_perm, original.ant1, n_vis, sorted.ant1);
+        GatherIndicesHalideFloat(perm, inv_perm, original.ant2, n_vis, sorted.ant2);
+        GatherIndicesHalideFloat(perm, inv_perm, original.solution_map, n_vis, sorted.solution_map);
+        GatherVisibilitiesHalideFloat(perm, inv_perm, original.v_res_in, n_vis, sorted.v_res_in);
+        GatherVisibilitiesHalideFloat(perm, inv_perm, original.model, n_vis, sorted.model);
+    }, repetitions);
+
+    Buffer<double> solve_original = original.output(), solve_sorted = sorted.output();
+    double solve_original_ms = time_ms([&]{ original.solve(SolveDirectionFloat, solve_original); }, repetitions);
+    double solve_sorted_ms = time_ms([&]{ sorted.solve(SolveDirectionFloat, solve_sorted); }, repetitions);
+
+    Buffer<float> sub_original(2, 2, 2, n_vis), sub_sorted(2, 2, 2, n_vis), sub_restored(2, 2, 2, n_vis);
+    double sub_original_ms = time_ms([&]{ original.subtract(SubDirectionFloat, sub_original); }, repetitions);
+    double sub_sorted_ms = time_ms([&]{ sorted.subtract(SubDirectionFloat, sub_sorted); }, repetitions);
+    double restore_ms = time_ms([&]{
+        RestoreVisibilitiesHalideFloat(perm, inv_perm, sub_sorted, n_vis, sub_restored);
+    }, repetitions);
+
+    printf("%-14s %12s %12s %12s\n", "", "time order", "sorted", "rel. error");
+    printf("%-14s %12s %12.3f\n", "gather", "", gather_ms);
+    printf("%-14s %12.3f %12.3f %12.3g\n", "SolveDirection", solve_original_ms, solve_sorted_ms,
+        relative_error(solve_sorted, solve_original));
+    printf("%-14s %12.3f %12.3f %12.3g\n", "SubDirection", sub_original_ms, sub_sorted_ms + restore_ms,
+        relative_error(sub_restored, sub_original));
+    return 0;
+}
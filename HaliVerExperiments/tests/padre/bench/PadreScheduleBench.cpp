@@ -0,0 +1,66 @@
+// Compares the schedules of PerformIterationHalide (GenerateHalideFull) and
+// SolveDirectionHalide (GenerateHalideDiagonal), see build_padre_library in CMakeLists.txt
+// for the variants. Reports the time of each schedule and its difference with the first.
+//   ./PadreScheduleBench [n_antennas] [n_times] [n_dirs] [n_cb] [repetitions]
+#include "PadreData.h"
+#include <stdio.h>
+#include <string>
+
+#include "PerformIterationHalideFloat.h"
+#include "PerformIterationHalideRfactor.h"
+#include "PerformIterationHalideChunked.h"
+#include "SolveDirectionHalideFloat.h"
+#include "SolveDirectionHalidePrivate.h"
+
+struct Schedule {
+    std::string name;
+    decltype(&PerformIterationHalideFloat) perform_iteration;
+};
+
+struct DiagonalSchedule {
+    std::string name;
+    decltype(&SolveDirectionFloat) solve_direction;
+};
+
+int main(int argc, char **argv){
+    int n_antennas = argc > 1 ? std::stoi(argv[1]) : 50;
+    int n_times = argc > 2 ? std::stoi(argv[2]) : 100;
+    int n_dirs = argc > 3 ? std::stoi(argv[3]) : 3;
+    int n_cb = argc > 4 ? std::stoi(argv[4]) : 1;
+    int repetitions = argc > 5 ? std::stoi(argv[5]) : 10;
+
+    std::vector<Schedule> schedules = {
+        {"0", PerformIterationHalideFloat},
+        {"1 rfactor", PerformIterationHalideRfactor},
+        {"2 chunked", PerformIterationHalideChunked},
+    };
+    std::vector<DiagonalSchedule> diagonal_schedules = {
+        {"2 rfactor", SolveDirectionFloat},
+        {"2 parts 32", SolveDirectionPrivate},
+    };
+
+    PadreData problem(n_antennas, n_times, n_dirs);
+    FullInputs full(problem, n_cb);
+    printf("%d antennas, %d visibilities, %d directions, %d channel blocks, median of %d runs\n",
+        n_antennas, problem.n_vis, n_dirs, n_cb, repetitions);
+    printf("%-12s %14s %12s\n", "schedule", "iteration ms", "rel. error");
+
+    Buffer<double> ref = full.output();
+    for(size_t k = 0; k < schedules.size(); k++){
+        Schedule &s = schedules[k];
+        Buffer<double> out = k == 0 ? ref : full.output();
+        double ms = time_ms([&]{ full.run(s.perform_iteration, out); }, repetitions);
+        printf("%-12s %14.3f %12.3g\n", s.name.c_str(), ms, relative_error(out, ref));
+    }
+
+    DiagonalInputs diagonal(problem);
+    printf("%-12s %14s %12s\n", "schedule", "solve dir ms", "rel. error");
+    Buffer<double> diagonal_ref = diagonal.output();
+    for(size_t k = 0; k < diagonal_schedules.size(); k++){
+        DiagonalSchedule &s = diagonal_schedules[k];
+        Buffer<double> out = k == 0 ? diagonal_ref : diagonal.output();
+        double ms = time_ms([&]{ diagonal.solve(s.solve_direction, out); }, repetitions);
+        printf("%-12s %14.3f %12.3g\n", s.name.c_str(), ms, relative_error(out, diagonal_ref));
+    }
+    return 0;
+}